@@ -0,0 +1,19 @@
+#ifndef _HTTP_BODY_STREAM_HPP
+#define _HTTP_BODY_STREAM_HPP
+#include "../looka_output_buffer.hpp"
+
+// A reply body made while it is sent. The server asks for the next part
+// once the last one is written out, so only a part of the body is held at
+// a time.
+class HttpBodyStream
+{
+public:
+  HttpBodyStream() {}
+  virtual ~HttpBodyStream() {}
+
+  // Appends the next part of the body to out, false when there was
+  // nothing left to append.
+  virtual bool Next(LookaOutputBuffer& out) = 0;
+};
+
+#endif //_HTTP_BODY_STREAM_HPP
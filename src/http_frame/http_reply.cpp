@@ -10,7 +10,7 @@ HttpReply::static_status_html_string = InitStatusHtmlString();
 const std::string HttpReply::static_name_value_separator = ": ";
 const std::string HttpReply::static_crlf = "\r\n";
 
-HttpReply::HttpReply(): status(STATUS_OK), content("")
+HttpReply::HttpReply(): status(STATUS_OK)
 {
 }
 
@@ -18,20 +18,20 @@ HttpReply::~HttpReply()
 {
 }
 
-std::string HttpReply::ToString()
+std::string HttpReply::HeaderString()
 {
-  std::string reply_string;
-  reply_string.append(HttpReply::StatusToString(status));
+  std::string header_string;
+  header_string.reserve(256);
+  header_string.append(HttpReply::StatusToString(status));
   for (size_t i = 0; i < headers.size(); i++) {
     Header& h = headers[i];
-    reply_string.append(h.name);
-    reply_string.append(HttpReply::static_name_value_separator);
-    reply_string.append(h.value);
-    reply_string.append(HttpReply::static_crlf);
+    header_string.append(h.name);
+    header_string.append(HttpReply::static_name_value_separator);
+    header_string.append(h.value);
+    header_string.append(HttpReply::static_crlf);
   }
-  reply_string.append(HttpReply::static_crlf);
-  reply_string.append(content);
-  return reply_string;
+  header_string.append(HttpReply::static_crlf);
+  return header_string;
 }
 
 int HttpReply::AddHeader(const std::string& name, const std::string& value)
@@ -42,6 +42,7 @@ int HttpReply::AddHeader(const std::string& name, const std::string& value)
   h.name = name;
   h.value = value;
   headers.push_back(h);
+  return 0;
 }
 
 std::string HttpReply::StatusToString(StatusType st)
@@ -66,9 +67,9 @@ HttpReply HttpReply::DirectReply(StatusType st)
 {
   HttpReply reply;
   reply.status = st;
-  reply.content = HttpReply::StatusToHtmlString(st);
+  reply.content.Append(HttpReply::StatusToHtmlString(st));
   std::stringstream ss_content_length;
-  ss_content_length << reply.content.length();
+  ss_content_length << reply.content.size();
   reply.AddHeader("Content-Length", ss_content_length.str());
   reply.AddHeader("Content-Type", "text/html");
   return reply;
@@ -101,6 +102,8 @@ std::map<HttpReply::StatusType, std::string> HttpReply::InitStatusString()
     "HTTP/1.1 403 Forbidden\r\n";
   status_string[STATUS_NOT_FOUND] =
     "HTTP/1.1 404 Not Found\r\n";
+  status_string[STATUS_REQUEST_ENTITY_TOO_LARGE] =
+    "HTTP/1.1 413 Request Entity Too Large\r\n";
   status_string[STATUS_INTERNAL_SERVER_ERROR] =
     "HTTP/1.1 500 Internal Server Error\r\n";
   status_string[STATUS_NOT_IMPLEMENTED] =
@@ -171,6 +174,11 @@ std::map<HttpReply::StatusType, std::string> HttpReply::InitStatusHtmlString()
     "<head><title>Not Found</title></head>"
     "<body><h1>404 Not Found</h1></body>"
     "</html>";
+  status_html_string[STATUS_REQUEST_ENTITY_TOO_LARGE] =
+    "<html>"
+    "<head><title>Request Entity Too Large</title></head>"
+    "<body><h1>413 Request Entity Too Large</h1></body>"
+    "</html>";
   status_html_string[STATUS_INTERNAL_SERVER_ERROR] =
     "<html>"
     "<head><title>Internal Server Error</title></head>"
@@ -3,7 +3,10 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 #include "header.hpp"
+#include "http_body_stream.hpp"
+#include "../looka_output_buffer.hpp"
 
 
 class HttpReply {
@@ -24,13 +27,15 @@ public:
     STATUS_UNAUTHORIZED = 401,
     STATUS_FORBIDDEN = 403,
     STATUS_NOT_FOUND = 404,
+    STATUS_REQUEST_ENTITY_TOO_LARGE = 413,
     STATUS_INTERNAL_SERVER_ERROR = 500,
     STATUS_NOT_IMPLEMENTED = 501,
     STATUS_BAD_GATEWAY = 502,
     STATUS_SERVICE_UNAVAILABLE = 503
   };
 public:
-  std::string ToString();
+  // The status line and the headers up to and with the empty line.
+  std::string HeaderString();
   int AddHeader(const std::string& name, const std::string& value);
   
 public:
@@ -41,7 +46,9 @@ public:
 public:
   StatusType status;
   std::vector<Header> headers;
-  std::string content;
+  LookaOutputBuffer content;
+  // set when the body is made while it is sent, content is empty then
+  std::shared_ptr<HttpBodyStream> stream;
 
 private:
   static std::map<StatusType, std::string> InitStatusString();
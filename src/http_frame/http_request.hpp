@@ -1,33 +1,45 @@
 #ifndef _HTTP_REQUEST_HPP
 #define _HTTP_REQUEST_HPP
+#include <strings.h>
 #include <string>
 #include <vector>
-#include "header.hpp"
+#include "../looka_string_piece.hpp"
 
+struct RequestHeader {
+  StringPiece name;
+  StringPiece value;
+};
+
+// A request as it was read. Every piece points into the read buffer of
+// the connection and is only valid while the request is handled, the
+// uri and the content are not url decoded.
 class HttpRequest
 {
 public:
-  HttpRequest():
-    method(""), uri(""),
-    http_version_major(0), http_version_minor(0), content("") {
+  HttpRequest(): http_version_major(0), http_version_minor(0) {
   }
   virtual ~HttpRequest() {}
 
-  std::string GetHeaderValue(const std::string& name) {
+  // Header names are case insensitive, an empty piece if it is missing.
+  StringPiece GetHeaderValue(const char* name) const {
     for (size_t i = 0; i < headers.size(); i++) {
-      if (headers[i].name == name)
+      if (EqualsIgnoreCase(headers[i].name, name))
         return headers[i].value;
     }
-    return "";
+    return StringPiece();
+  }
+
+  static bool EqualsIgnoreCase(const StringPiece& s, const char* t) {
+    return s.size() == strlen(t) && strncasecmp(s.data(), t, s.size()) == 0;
   }
 
 public:
-  std::string method;
-  std::string uri;
+  StringPiece method;
+  StringPiece uri;
   unsigned int http_version_major;
   unsigned int http_version_minor;
-  std::vector<Header> headers;
-  std::string content;
+  std::vector<RequestHeader> headers;
+  StringPiece content;
 };
 
 #endif //_HTTP_REQUEST_HPP
@@ -1,104 +1,94 @@
-#include <stdio.h>
-#include "header.hpp"
+#include <stdint.h>
+#include <ctype.h>
+#include <string.h>
 #include "http_request_parser.hpp"
 
 int HttpRequestParser::ParseHeader(
-  HttpRequest& req, const std::string& httpheader)
+  HttpRequest& req, const char* header, size_t size)
 {
-  std::vector<std::string> pieces;
-  if (SplitString(httpheader, "\r\n", pieces) == 0)
-    return -1;
+  const char* p = header;
+  const char* end = header + size;
+  req.headers.clear();
 
   // First line in header: GET /xxxx HTTP/1.1
-  std::vector<std::string> firstline;
-  if (SplitString(pieces[0], " ", firstline) != 3)
+  const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+  if (eol == NULL)
+    return -1;
+  const char* line_end = (eol > p && *(eol - 1) == '\r') ? eol - 1 : eol;
+  const char* sp1 = static_cast<const char*>(memchr(p, ' ', line_end - p));
+  if (sp1 == NULL || sp1 == p)
     return -1;
-  if (sscanf(firstline[2].c_str(), "HTTP/%u.%u",
-      &req.http_version_major, &req.http_version_minor) != 2)
+  const char* sp2 =
+    static_cast<const char*>(memchr(sp1 + 1, ' ', line_end - sp1 - 1));
+  if (sp2 == NULL || sp2 == sp1 + 1)
     return -1;
-  req.method = firstline[0];
-  req.uri    = UrlDecode(firstline[1]);
+  const char* v = sp2 + 1;
+  if (line_end - v != 8 || strncmp(v, "HTTP/", 5) != 0 ||
+      !isdigit(v[5]) || v[6] != '.' || !isdigit(v[7]))
+    return -1;
+  req.method = StringPiece(p, sp1 - p);
+  req.uri    = StringPiece(sp1 + 1, sp2 - sp1 - 1);
+  req.http_version_major = v[5] - '0';
+  req.http_version_minor = v[7] - '0';
 
-  Header h;
-  for (size_t i = 1; i < pieces.size(); i++) {
-    if (pieces[i].empty()) continue;
-    size_t p = pieces[i].find_first_of(":");
-    if (p != std::string::npos) {
-      h.name  = Trim(pieces[i].substr(0, p));
-      h.value = Trim(pieces[i].substr(p + 1));
-      req.headers.push_back(h);
-    }
+  RequestHeader h;
+  for (p = eol + 1; p < end; p = eol + 1) {
+    eol = static_cast<const char*>(memchr(p, '\n', end - p));
+    if (eol == NULL)
+      eol = end;
+    line_end = (eol > p && *(eol - 1) == '\r') ? eol - 1 : eol;
+    const char* colon =
+      static_cast<const char*>(memchr(p, ':', line_end - p));
+    if (colon == NULL) continue;
+    h.name  = Trim(p, colon);
+    h.value = Trim(colon + 1, line_end);
+    req.headers.push_back(h);
   }
   return 0;
 }
 
-int HttpRequestParser::ParseContent(
-  HttpRequest& req, const std::string& httpcontent)
+int HttpRequestParser::ParseContentLength(
+  const HttpRequest& req, size_t& length)
 {
-  req.content = UrlDecode(httpcontent);
+  length = 0;
+  StringPiece s = req.GetHeaderValue("Content-Length");
+  for (const char* p = s.begin(); p != s.end(); p++) {
+    if (!isdigit(*p) || length > (SIZE_MAX - 9) / 10)
+      return -1;
+    length = length * 10 + (*p - '0');
+  }
   return 0;
 }
 
-std::string HttpRequestParser::UrlDecode(const std::string& s)
+static int HexValue(char c)
 {
-  std::string result;
-  int hex = 0;
-  for (size_t i = 0; i < s.length(); i++) {
-    switch (s[i]) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return c - 'A' + 10;
+}
+
+void HttpRequestParser::UrlDecode(const StringPiece& s, std::string& out)
+{
+  const char* p = s.data();
+  size_t n = s.size();
+  for (size_t i = 0; i < n; i++) {
+    switch (p[i]) {
     case '+':
-      result += ' ';
+      out += ' ';
       break;
     case '%':
-      if (isxdigit(s[i + 1]) && isxdigit(s[i + 2])) {
-        std::string hexStr = s.substr(i + 1, 2);
-        hex = strtol(hexStr.c_str(), 0, 16);
-        // 字母和数字[0-9a-zA-Z]、一些特殊符号[$-_.+!*'(),] 、
-        // 以及某些保留字[$&+,/:;=?@]可以不经过编码直接用于URL
-        if (!((hex >= 48 && hex <= 57) || // 0-9
-            (hex >=97 && hex <= 122) || // a-z
-            (hex >=65 && hex <= 90) || // A-Z
-            //一些特殊符号及保留字[$-_.+!*'(),&/:;=?@]
-            hex == 0x21 || hex == 0x24 || hex == 0x26 ||
-            hex == 0x27 || hex == 0x28 || hex == 0x29 ||
-            hex == 0x2a || hex == 0x2b|| hex == 0x2c ||
-            hex == 0x2d || hex == 0x2e || hex == 0x2f ||
-            hex == 0x3A || hex == 0x3B|| hex == 0x3D ||
-            hex == 0x3f || hex == 0x40 || hex == 0x5f)) {
-          result += char(hex);
-          i += 2;
-        } else {
-          result += '%';
-        }
+      if (i + 2 < n && isxdigit(p[i + 1]) && isxdigit(p[i + 2])) {
+        out += char(HexValue(p[i + 1]) * 16 + HexValue(p[i + 2]));
+        i += 2;
       } else {
-        result += '%';
+        out += '%';
       }
       break;
     default:
-      result += s[i];
+      out += p[i];
       break;
     }
   }
-  return result;
-}
-
-size_t HttpRequestParser::SplitString(
-  const std::string& str,
-  const std::string& split,
-  std::vector<std::string>& pieces)
-{
-  pieces.clear();
-  size_t curr_pos = 0;
-  size_t last_pos = 0;
-  while ((curr_pos = str.find(split, last_pos)) != std::string::npos) {
-    std::string piece = str.substr(last_pos, curr_pos - last_pos);
-    pieces.push_back(piece);
-    last_pos = curr_pos + split.length();
-  }
-  if (last_pos > 0 && last_pos < str.length()) {
-    std::string piece = str.substr(last_pos);
-    pieces.push_back(piece);
-  }
-  return pieces.size();
 }
 
 bool HttpRequestParser::IsSpace(const char& c)
@@ -108,14 +98,9 @@ bool HttpRequestParser::IsSpace(const char& c)
 	return false;
 }
 
-std::string HttpRequestParser::Trim(const std::string& str)
+StringPiece HttpRequestParser::Trim(const char* begin, const char* end)
 {
-	if (str.empty()) return str;
-  std::string s = str;
-	std::string::iterator it;
-	for (it=s.begin(); it!=s.end() && IsSpace(*it++););
-	s.erase(s.begin(), --it);
-	for (it=s.end(); it!=s.begin() && IsSpace(*--it););
-	s.erase(++it, s.end());
-  return s;
+  while (begin < end && IsSpace(*begin)) begin++;
+  while (end > begin && IsSpace(*(end - 1))) end--;
+  return StringPiece(begin, end - begin);
 }
@@ -7,18 +7,20 @@ class HttpRequestParser
 public:
   HttpRequestParser() {}
   virtual ~HttpRequestParser() {}
-  
-  static int ParseHeader(HttpRequest& req, const std::string& httpheader);
-  static int ParseContent(HttpRequest& req, const std::string& httpcontent);
-  static std::string UrlDecode(const std::string& s);
+
+  // Parses the request line and the headers in one pass over the header
+  // block, up to and with the empty line. The pieces of req point into
+  // the block.
+  static int ParseHeader(HttpRequest& req, const char* header, size_t size);
+  // Content-Length of a request, 0 without one. -1 if it is not a
+  // number.
+  static int ParseContentLength(const HttpRequest& req, size_t& length);
+  // Appends the url decoded s to out.
+  static void UrlDecode(const StringPiece& s, std::string& out);
 
 private:
-  static std::string Trim(const std::string& str);
+  static StringPiece Trim(const char* begin, const char* end);
   static bool IsSpace(const char& c);
-  static size_t SplitString(
-    const std::string& str,
-    const std::string& split,
-    std::vector<std::string>& pieces);
 };
 
 #endif //_HTTP_REQUEST_PARSER_HPP
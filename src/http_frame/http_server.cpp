@@ -1,10 +1,16 @@
 #include <sstream>
+#include <algorithm>
+#include <stdio.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <strings.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
 #include "http_server.hpp"
 #include "http_request.hpp"
 #include "http_request_parser.hpp"
@@ -14,16 +20,15 @@
 
 HttpServer::HttpServer(unsigned short _listen_port, size_t _threads_num)
 {
-  m_listen_fd = HTTP_INVALID_FD;
-  m_epoll_fd = HTTP_INVALID_FD;
   m_listen_port = _listen_port;
   m_threads_num = _threads_num;
-  m_threads = NULL;
+  m_threads_started = 0;
+  m_workers = NULL;
+  m_reuse_port = true;
 
   m_running = false;
-  m_epoll_ready_event_num = 0;
-
-  pthread_mutex_init(&m_epoll_mutex, NULL);
+  m_idle_timeout = HTTP_IDLE_TIMEOUT;
+  m_read_timeout = HTTP_READ_TIMEOUT;
   m_handler = NULL;
 
   m_server_name = "lchttpd";
@@ -32,14 +37,25 @@ HttpServer::HttpServer(unsigned short _listen_port, size_t _threads_num)
 HttpServer::~HttpServer()
 {
   Stop();
-  if (m_threads_num > 0) {
+  if (m_workers) {
+    for (int i = 0; i < m_threads_started; i++)
+      pthread_join(m_workers[i].thread, NULL);
     for (int i = 0; i < m_threads_num; i++) {
-      pthread_join(m_threads[i], NULL);
+      Worker& w = m_workers[i];
+      std::map<int, Connection>::iterator it;
+      for (it = w.connections.begin(); it != w.connections.end(); ++it)
+        close(it->first);
+      if (w.epoll_fd != HTTP_INVALID_FD)
+        close(w.epoll_fd);
+      if (w.timer_fd != HTTP_INVALID_FD)
+        close(w.timer_fd);
+      if (w.spare_fd != HTTP_INVALID_FD)
+        close(w.spare_fd);
+      if (w.listen_fd != HTTP_INVALID_FD && (i == 0 || m_reuse_port))
+        close(w.listen_fd);
     }
-    delete [] m_threads;
+    delete [] m_workers;
   }
-
-  pthread_mutex_destroy(&m_epoll_mutex);
 }
 
 int HttpServer::SetServerHandler(ServerHandler* h)
@@ -54,21 +70,63 @@ int HttpServer::SetServerName(const std::string& server_name)
   return 0;
 }
 
+int HttpServer::SetIdleTimeout(int seconds)
+{
+  m_idle_timeout = seconds;
+  return 0;
+}
+
+int HttpServer::SetReadTimeout(int seconds)
+{
+  m_read_timeout = seconds;
+  return 0;
+}
+
 int HttpServer::Start()
 {
-  if (CreateEpoll(m_epoll_fd, HTTP_MAX_FD))
-    return -1;
-  if (CreateListen(m_listen_fd, HTTP_MAX_FD))
-    return -1;
-  if (AddEvent(m_listen_fd))
+  if (m_threads_num <= 0 || m_workers)
     return -1;
 
+  m_workers = new Worker[m_threads_num];
+  for (int i = 0; i < m_threads_num; i++) {
+    m_workers[i].server = this;
+    m_workers[i].epoll_fd = HTTP_INVALID_FD;
+    m_workers[i].listen_fd = HTTP_INVALID_FD;
+    m_workers[i].timer_fd = HTTP_INVALID_FD;
+    m_workers[i].spare_fd = open("/dev/null", O_RDONLY);
+    m_workers[i].date_time = 0;
+  }
+
+  // with SO_REUSEPORT the kernel spreads the connections over the listen
+  // sockets of the workers, without it they all accept from one
+  for (int i = 0; i < m_threads_num; i++) {
+    Worker& w = m_workers[i];
+    if (CreateEpoll(w.epoll_fd, HTTP_MAX_FD))
+      return -1;
+    if (i > 0 && !m_reuse_port) {
+      w.listen_fd = m_workers[0].listen_fd;
+    } else if (CreateListen(w.listen_fd, HTTP_MAX_FD, m_reuse_port)) {
+      if (i > 0 || !m_reuse_port)
+        return -1;
+      m_reuse_port = false;
+      if (CreateListen(w.listen_fd, HTTP_MAX_FD, false))
+        return -1;
+    }
+    if (AddEvent(w.epoll_fd, w.listen_fd, EPOLLIN | EPOLLET))
+      return -1;
+    if (CreateTimer(w.timer_fd) || AddEvent(w.epoll_fd, w.timer_fd, EPOLLIN))
+      return -1;
+  }
+  _INFO("[HttpServer] [Listening *:%hu] [threads %d] [reuse_port %d]",
+    m_listen_port, m_threads_num, m_reuse_port ? 1 : 0);
+
   m_running = true;
 
-  m_threads = new pthread_t[m_threads_num];
-  for (int i = 0; i < m_threads_num; i++)
-    if (pthread_create(&m_threads[i], NULL, Routine, this))
+  for (; m_threads_started < m_threads_num; m_threads_started++) {
+    Worker& w = m_workers[m_threads_started];
+    if (pthread_create(&w.thread, NULL, Routine, &w))
       return -1;
+  }
 
   return 0;
 }
@@ -81,90 +139,271 @@ int HttpServer::Stop()
 
 void* HttpServer::Routine(void* arg)
 {
-  (static_cast<HttpServer*>(arg))->Run();
+  Worker* worker = static_cast<Worker*>(arg);
+  worker->server->Run(worker);
   return NULL;
 }
 
-int HttpServer::Run()
+int HttpServer::Run(Worker* worker)
 {
   while (m_running) {
-    pthread_mutex_lock(&m_epoll_mutex);
-    if (m_epoll_ready_event_num <= 0) {
-      m_epoll_ready_event_num =
-        epoll_wait(m_epoll_fd, m_epoll_ready_events, HTTP_MAX_FD, -1);
-    }
-    if (m_epoll_ready_event_num-- < 0) {
-      pthread_mutex_unlock(&m_epoll_mutex);
-      continue;
+    int n = epoll_wait(worker->epoll_fd, worker->events, HTTP_MAX_FD, -1);
+    for (int i = 0; i < n; i++) {
+      int fd = worker->events[i].data.fd;
+      if (fd == worker->listen_fd) {
+        AcceptConnections(worker);
+        continue;
+      }
+      if (fd == worker->timer_fd) {
+        uint64_t expirations;
+        if (read(fd, &expirations, sizeof(expirations)) > 0)
+          CloseExpiredConnections(worker, time(NULL));
+        continue;
+      }
+      std::map<int, Connection>::iterator it = worker->connections.find(fd);
+      if (it != worker->connections.end())
+        ServeConnection(worker, fd, it->second);
     }
+  }
+  return 0;
+}
 
-    int new_fd = HTTP_INVALID_FD;
-    int fd = m_epoll_ready_events[m_epoll_ready_event_num].data.fd;
-    if (fd == m_listen_fd) {
-      struct sockaddr_in addr;
-      socklen_t addr_len;
-      while ((new_fd = accept(fd, (struct sockaddr*)&addr, &addr_len)) >= 0) {
-        SetSocket(new_fd);
-        AddEvent(new_fd);
+int HttpServer::AcceptConnections(Worker* worker)
+{
+  struct sockaddr_in addr;
+  socklen_t addr_len;
+  time_t now = time(NULL);
+  // the listen socket is edge triggered, so the queue is taken until it
+  // is empty or nothing more can be taken
+  while (true) {
+    addr_len = sizeof(addr);
+    int fd = accept(worker->listen_fd, (struct sockaddr*)&addr, &addr_len);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      if ((errno == EMFILE || errno == ENFILE) &&
+          worker->spare_fd != HTTP_INVALID_FD) {
+        // out of fds, the spare one makes room to take the connection
+        // off the queue and close it, else it would wait for an edge that
+        // only comes with the next client
+        _ERROR("[accept fail] [%s] [connection dropped]", strerror(errno));
+        close(worker->spare_fd);
+        fd = accept(worker->listen_fd, NULL, NULL);
+        if (fd >= 0)
+          close(fd);
+        worker->spare_fd = open("/dev/null", O_RDONLY);
+        if (fd >= 0)
+          continue;
+        break;
       }
-      // accept
-      pthread_mutex_unlock(&m_epoll_mutex);
-      continue;
+      _ERROR("[accept fail] [%s]", strerror(errno));
+      break;
     }
-    DelEvent(fd);
-    pthread_mutex_unlock(&m_epoll_mutex);
 
-    int ret;
-    HttpReply reply;
-    if ((ret = HandleRequest(fd, reply)) != 0) {
-      _INFO("[bad request r %d]", ret);
+    SetSocket(fd);
+    // edge triggered, waiting for a request first
+    if (AddEvent(worker->epoll_fd, fd, EPOLLIN | EPOLLET)) {
+      close(fd);
+    } else {
+      Connection& conn = worker->connections[fd];
+      conn = Connection();
+      conn.events = EPOLLIN;
+      conn.last_active = now;
     }
-    if ((ret = SendReply(fd, reply)) != 0) {
-      _INFO("[send reply fail]");
-    }
-    close(fd);
   }
   return 0;
 }
 
-int HttpServer::HandleRequest(int fd, HttpReply& reply)
+int HttpServer::ServeConnection(Worker* worker, int fd, Connection& conn)
 {
-  Buffer       buffer;
-  HttpRequest  request;
-  timeval      timeout = {0, HTTP_READ_TIMEOUT * 1000};
+  time_t now = time(NULL);
+  // pipelined requests are served in order, one reply at a time, and
+  // nothing more is read while a reply is going out, so a client that
+  // does not take its replies cannot make the buffer grow
+  bool readable = true;
+  while (true) {
+    if (conn.state == CONN_WRITING) {
+      int ret = WriteReply(fd, conn, now);
+      if (ret < 0) {
+        _INFO("[send reply fail]");
+        return CloseConnection(worker, fd);
+      }
+      if (ret > 0) {
+        if (WaitFor(worker, fd, conn, EPOLLOUT))
+          return CloseConnection(worker, fd);
+        return 0;
+      }
+      if (!conn.keep_alive)
+        return CloseConnection(worker, fd);
+      conn.state = CONN_READING;
+      conn.last_active = now;
+    }
 
-  if (ReadHttpHeaderTimeout(fd, buffer, &timeout) < 0) {
-    reply = HttpReply::DirectReply(HttpReply::STATUS_BAD_REQUEST);
-    return -1;
+    HttpReply reply;
+    if (NextRequest(conn, reply)) {
+      StartReply(worker, conn, reply, now);
+      continue;
+    }
+    if (!readable || conn.peer_closed)
+      break;
+    // the buffer holds a whole request once it is full, so the next
+    // round either serves one or fails the request
+    int ret = ReadAvailable(fd, conn, now);
+    if (ret < 0)
+      return CloseConnection(worker, fd);
+    readable = ret > 0;
   }
 
-  if (HttpRequestParser::ParseHeader(request, buffer.read_buf[0]) != 0) {
-    reply = HttpReply::DirectReply(HttpReply::STATUS_BAD_REQUEST);
-    return -2;
+  if (conn.peer_closed)
+    return CloseConnection(worker, fd);
+  if (WaitFor(worker, fd, conn, EPOLLIN))
+    return CloseConnection(worker, fd);
+  return 0;
+}
+
+int HttpServer::ReadAvailable(int fd, Connection& conn, time_t now)
+{
+  // 0 when all there is was read, 1 when the buffer is full
+  // drop the requests already served, the buffer itself is kept
+  std::string& buf = conn.read_buf;
+  if (conn.request_start > 0) {
+    buf.erase(0, conn.request_start);
+    conn.scan_pos -= conn.request_start;
+    if (conn.header_end > 0)
+      conn.header_end -= conn.request_start;
+    conn.request_start = 0;
   }
 
-  std::string length_str = request.GetHeaderValue("Content-Length");
-  if (!length_str.empty()) {
-    int length = atoi(length_str.c_str());
-    if (ReadHttpContentTimeout(fd, buffer, length, &timeout) != length) {
-      reply = HttpReply::DirectReply(HttpReply::STATUS_BAD_REQUEST);
-      return -3;
+  bool idle = buf.empty();
+  int ret = 0;
+  while (!conn.peer_closed) {
+    size_t size = buf.size();
+    if (size >= HTTP_READ_BUF_MAX) {
+      ret = 1;
+      break;
     }
-    if (HttpRequestParser::ParseContent(request, buffer.read_buf[0]) != 0) {
-      reply = HttpReply::DirectReply(HttpReply::STATUS_BAD_REQUEST);
-      return -4;
+    size_t room = std::min((size_t)HTTP_READ_BUF_SIZE,
+      (size_t)HTTP_READ_BUF_MAX - size);
+    buf.resize(size + room);
+    ssize_t n = read(fd, &buf[size], room);
+    buf.resize(size + (n > 0 ? n : 0));
+    if (n > 0)
+      continue;
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    if (n < 0)
+      return -1;
+    conn.peer_closed = true;
+  }
+
+  // a request started, it has m_read_timeout to arrive
+  if (idle && !buf.empty() && conn.state == CONN_READING)
+    conn.last_active = now;
+  return ret;
+}
+
+static bool IsHttp11(const HttpRequest& request)
+{
+  return request.http_version_major > 1 ||
+    (request.http_version_major == 1 && request.http_version_minor >= 1);
+}
+
+// HTTP/1.1 keeps the connection unless told to close it, HTTP/1.0 only
+// when asked to keep it.
+static bool IsKeepAlive(HttpRequest& request)
+{
+  StringPiece connection = request.GetHeaderValue("Connection");
+  if (IsHttp11(request))
+    return !HttpRequest::EqualsIgnoreCase(connection, "close");
+  return HttpRequest::EqualsIgnoreCase(connection, "keep-alive");
+}
+
+int HttpServer::NextRequest(Connection& conn, HttpReply& reply)
+{
+  std::string& buf = conn.read_buf;
+  int ret = 0;
+  if (conn.header_end == 0) {
+    size_t pos = buf.find("\r\n\r\n", conn.scan_pos);
+    if (pos == std::string::npos) {
+      // the end may be split over reads, its start is in the last bytes
+      conn.scan_pos = std::max(conn.request_start,
+        buf.size() >= 3 ? buf.size() - 3 : 0);
+      if (buf.size() - conn.request_start <= HTTP_HEADER_MAX_LENGTH)
+        return 0;
+      ret = -1;
+    } else if (pos + 4 - conn.request_start > HTTP_HEADER_MAX_LENGTH) {
+      ret = -1;
+    } else {
+      conn.header_end = pos + 4;
     }
   }
 
-  std::string handle_reply_str;
+  // the request points into buf, which moves between reads, so the
+  // header is parsed again while the content is still coming
+  if (ret == 0 && HttpRequestParser::ParseHeader(conn.request,
+        buf.data() + conn.request_start,
+        conn.header_end - conn.request_start) != 0)
+    ret = -2;
+  if (ret == 0 &&
+      HttpRequestParser::ParseContentLength(
+        conn.request, conn.content_length) != 0)
+    ret = -3;
+  if (ret == 0 && conn.content_length > HTTP_CONTENT_MAX_LENGTH)
+    ret = -4;
+  if (ret == 0) {
+    if (buf.size() - conn.header_end < conn.content_length)
+      return 0;
+    conn.request.content =
+      StringPiece(buf.data() + conn.header_end, conn.content_length);
+  }
+
+  if (ret == 0) {
+    // the request is framed, the next one may follow on the connection
+    conn.keep_alive = IsKeepAlive(conn.request);
+    ret = HandleRequest(conn.request, reply);
+    conn.request_start = conn.header_end + conn.content_length;
+  } else {
+    // the framing is lost, nothing after this can be read, a content too
+    // large to take is not read either
+    reply = HttpReply::DirectReply(ret == -4 ?
+      HttpReply::STATUS_REQUEST_ENTITY_TOO_LARGE :
+      HttpReply::STATUS_BAD_REQUEST);
+    conn.keep_alive = false;
+    conn.request_start = buf.size();
+  }
+  if (ret != 0)
+    _INFO("[bad request r %d]", ret);
+
+  conn.scan_pos = conn.request_start;
+  conn.header_end = 0;
+  conn.content_length = 0;
+  return 1;
+}
+
+int HttpServer::HandleRequest(HttpRequest& request, HttpReply& reply)
+{
   std::string extension;
 
-  if (m_handler && m_handler->Process(request, handle_reply_str, extension)) {
+  if (m_handler &&
+      m_handler->Process(request, reply.content, reply.stream, extension)) {
     reply.status = HttpReply::STATUS_OK;
-    reply.content = handle_reply_str;
-    std::stringstream ss_content_length;
-    ss_content_length << reply.content.length();
-    reply.AddHeader("Content-Length", ss_content_length.str());
+    if (reply.stream && IsHttp11(request)) {
+      // sent while it is made, the length is not known up front
+      reply.AddHeader("Transfer-Encoding", "chunked");
+    } else {
+      // HTTP/1.0 has no chunked encoding, the body is made first
+      if (reply.stream) {
+        while (reply.stream->Next(reply.content));
+        reply.stream.reset();
+      }
+      std::stringstream ss_content_length;
+      ss_content_length << reply.content.size();
+      reply.AddHeader("Content-Length", ss_content_length.str());
+    }
     reply.AddHeader("Content-Type", MimeType::ExtensionToType(extension));
   } else {
     reply = HttpReply::DirectReply(HttpReply::STATUS_NOT_FOUND);
@@ -174,87 +413,156 @@ int HttpServer::HandleRequest(int fd, HttpReply& reply)
   return 0;
 }
 
-int HttpServer::SendReply(int fd, HttpReply& reply)
+int HttpServer::StartReply(
+  Worker* worker, Connection& conn, HttpReply& reply, time_t now)
 {
-  reply.AddHeader("Date", GetServerTime());
+  reply.AddHeader("Date", GetServerTime(worker, now));
   reply.AddHeader("Server", m_server_name);
-
-  timeval timeout = {0, HTTP_WRITE_TIMEOUT * 1000};
-  std::string write_buf = reply.ToString();
-  if (WriteTimeout(fd, write_buf.c_str(), write_buf.length(), &timeout) !=
-      static_cast<int>(write_buf.length())) {
-    return -1;
-  }
+  reply.AddHeader("Connection", conn.keep_alive ? "keep-alive" : "close");
+
+  conn.write_header = reply.HeaderString();
+  conn.write_body.Swap(reply.content);
+  conn.write_stream = reply.stream;
+  conn.write_pos = 0;
+  conn.state = CONN_WRITING;
+  conn.last_active = now;
   return 0;
 }
 
-int HttpServer::ReadHttpHeaderTimeout(
-  int fd, Buffer& buffer, timeval* timeout)
+int HttpServer::WriteReply(int fd, Connection& conn, time_t now)
 {
-  int n;
-  int pos;
-  char buf[HTTP_READ_BUF_SIZE + 1];
-  std::string& ahead  = buffer.read_buf[0];
-  std::string& behind = buffer.read_buf[1];
+  // 0 when the reply is out, 1 when the socket is full
   while (true) {
-    if ((pos = ahead.find("\r\n\r\n")) >= 0) {
-      behind = ahead.substr(pos + 4);
-      ahead  = ahead.substr(0, pos + 4);
-      return 0;
-    }
-    if ((n = ReadOnceTimeout(fd, buf, HTTP_READ_BUF_SIZE, timeout)) <= 0)
+    const LookaOutputBuffer& body = conn.write_body;
+    size_t total = conn.write_header.size() + body.size();
+    while (conn.write_pos < total) {
+      // what is left from write_pos on, the header being the first chunk
+      struct iovec iov[HTTP_WRITE_IOV_NUM];
+      int iov_num = 0;
+      size_t skip = conn.write_pos;
+      size_t chunk_num = body.GetChunkNum() + 1;
+      for (size_t i = 0; i < chunk_num && iov_num < HTTP_WRITE_IOV_NUM; i++) {
+        const std::string& chunk =
+          i == 0 ? conn.write_header : body.GetChunk(i - 1);
+        if (skip >= chunk.size()) {
+          skip -= chunk.size();
+          continue;
+        }
+        iov[iov_num].iov_base = const_cast<char*>(chunk.data()) + skip;
+        iov[iov_num].iov_len = chunk.size() - skip;
+        iov_num++;
+        skip = 0;
+      }
+      ssize_t n = writev(fd, iov, iov_num);
+      if (n > 0) {
+        // a slow client that keeps taking the reply is not timed out
+        conn.write_pos += n;
+        conn.last_active = now;
+        continue;
+      }
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return 1;
       return -1;
-    buf[n] = '\0';
-    ahead += buf;
+    }
+    // the part is out, a streamed body goes on with the next one
+    if (!conn.write_stream)
+      break;
+    NextPart(conn);
   }
-  return -1;
+  conn.write_header.clear();
+  conn.write_body.Clear();
+  conn.write_pos = 0;
+  return 0;
 }
 
-int HttpServer::ReadHttpContentTimeout(
-  int fd, Buffer& buffer, int len, timeval* timeout)
+int HttpServer::NextPart(Connection& conn)
 {
-  int n;
-  int read_len;
-  char buf[HTTP_READ_BUF_SIZE + 1];
-  std::string& ahead  = buffer.read_buf[0];
-  std::string& behind = buffer.read_buf[1];
-
-  int left = len - behind.length();
-  if (left < 0) {
-    ahead  = behind.substr(0, len);
-    behind = behind.substr(len);
-    return len;
+  // every part is a chunk of its own, an empty chunk ends the body
+  conn.write_header.clear();
+  conn.write_body.Clear();
+  conn.write_pos = 0;
+  bool more = conn.write_stream->Next(conn.write_body);
+  if (!conn.write_body.empty()) {
+    char size_line[32];
+    conn.write_header.assign(size_line, snprintf(size_line,
+      sizeof(size_line), "%zx\r\n", conn.write_body.size()));
+    conn.write_body.Append("\r\n", 2);
+  }
+  if (!more) {
+    conn.write_body.Append("0\r\n\r\n", 5);
+    conn.write_stream.reset();
   }
+  return 0;
+}
 
-  ahead  = behind;
-  behind = "";
-  while (left > 0) {
-    read_len = left > HTTP_READ_BUF_SIZE ? HTTP_READ_BUF_SIZE : left;
-    if ((n = ReadOnceTimeout(fd, buf, read_len, timeout)) <= 0) {
-      return len - left;
-    }
-    buf[n] = '\0';
-    ahead += buf;
-    left -= n;
+int HttpServer::CloseConnection(Worker* worker, int fd)
+{
+  DelEvent(worker->epoll_fd, fd);
+  close(fd);
+  worker->connections.erase(fd);
+  return 0;
+}
+
+int HttpServer::CloseExpiredConnections(Worker* worker, time_t now)
+{
+  // an idle connection has m_idle_timeout for its next request, one that
+  // is reading a request has m_read_timeout for it, one writing a reply
+  // m_read_timeout for the client to take more of it
+  std::vector<int> expired;
+  std::map<int, Connection>::iterator it;
+  for (it = worker->connections.begin(); it != worker->connections.end(); ++it) {
+    const Connection& conn = it->second;
+    bool idle = conn.state == CONN_READING &&
+      conn.request_start == conn.read_buf.size();
+    if (now - conn.last_active >= (idle ? m_idle_timeout : m_read_timeout))
+      expired.push_back(it->first);
   }
-  return len;
+  for (size_t i = 0; i < expired.size(); i++)
+    CloseConnection(worker, expired[i]);
+  return 0;
+}
+
+int HttpServer::AddEvent(int epoll_fd, int fd, uint32_t events)
+{
+  epoll_event event;
+  event.events = events;
+  event.data.fd = fd;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event))
+    return -1;
+  return 0;
 }
 
-int HttpServer::AddEvent(int fd)
+int HttpServer::ModEvent(int epoll_fd, int fd, uint32_t events)
 {
   epoll_event event;
-  event.events = EPOLLIN | EPOLLET;
+  event.events = events;
   event.data.fd = fd;
-  epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event))
+    return -1;
+  return 0;
+}
+
+int HttpServer::WaitFor(
+  Worker* worker, int fd, Connection& conn, uint32_t events)
+{
+  // a request while reading, the socket to be writable while writing,
+  // the edge is armed again by the change
+  if (conn.events == events)
+    return 0;
+  if (ModEvent(worker->epoll_fd, fd, events | EPOLLET))
+    return -1;
+  conn.events = events;
   return 0;
 }
 
-int HttpServer::DelEvent(int fd)
+int HttpServer::DelEvent(int epoll_fd, int fd)
 {
   epoll_event event;
-  event.events = EPOLLIN | EPOLLET;
+  event.events = 0;
   event.data.fd = fd;
-  epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, &event);
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, &event);
   return 0;
 }
 
@@ -281,7 +589,7 @@ int HttpServer::CreateEpoll(int& fd, int max_fd)
   return 0;
 }
 
-int HttpServer::CreateListen(int& fd, int max_fd)
+int HttpServer::CreateListen(int& fd, int max_fd, bool reuse_port)
 {
   struct sockaddr_in addr;
   memset(&addr, 0, sizeof(addr));
@@ -291,57 +599,41 @@ int HttpServer::CreateListen(int& fd, int max_fd)
 
   if ((fd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
     return -1;
-  if (SetSocket(fd))
-    return -1;
-  if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)))
-    return -1;
-  if (listen(fd, max_fd))
+  int options = 1;
+  if (SetSocket(fd) ||
+      (reuse_port &&
+       setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &options, sizeof(int))) ||
+      bind(fd, (struct sockaddr*)&addr, sizeof(addr)) ||
+      listen(fd, max_fd)) {
+    close(fd);
+    fd = HTTP_INVALID_FD;
     return -1;
-
-  _INFO("[HttpServer] [Listening %s:%hu]",
-    inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+  }
   return 0;
 }
 
-int HttpServer::ReadOnceTimeout(
-  int fd, void* buf, size_t buf_len, timeval* timeout)
+int HttpServer::CreateTimer(int& fd)
 {
-  fd_set rset;
-  FD_ZERO(&rset);
-  FD_SET(fd, &rset);
-  if (select(fd + 1, &rset, NULL, NULL, timeout) <= 0)
+  if ((fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK)) == -1)
+    return -1;
+  struct itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+  spec.it_value.tv_sec = 1;
+  spec.it_interval.tv_sec = 1;
+  if (timerfd_settime(fd, 0, &spec, NULL))
     return -1;
-  return read(fd, buf, buf_len);
+  return 0;
 }
 
-int HttpServer::WriteTimeout(
-  int fd, const void *buf, size_t buf_len, timeval *timeout)
+const std::string& HttpServer::GetServerTime(Worker* worker, time_t now)
 {
-  int left = buf_len;
-  int n;
-  fd_set wset;
-
-  while (left > 0)
-  {
-    FD_ZERO(&wset);
-    FD_SET(fd, &wset);
-    if (select(fd + 1, NULL, &wset, NULL, timeout) <= 0)
-      return -1;
-    if ((n = write(fd, buf, left)) <= 0)
-      return buf_len - left;
-    buf = (char *)buf + n;
-    left -= n;
+  if (now != worker->date_time || worker->date.empty()) {
+    struct tm tmp_time;
+    char timestr[64] = {0};
+    strftime(timestr, sizeof(timestr),
+      "%a, %d %b %Y %H:%M:%S GMT", gmtime_r(&now, &tmp_time));
+    worker->date = timestr;
+    worker->date_time = now;
   }
-  return buf_len;
-}
-
-std::string HttpServer::GetServerTime()
-{
-  time_t t;
-  struct tm tmp_time;
-  time(&t);
-  char timestr[64] = {0};
-  strftime(timestr, sizeof(timestr),
-    "%a, %e %b %Y %H:%M:%S %Z", localtime_r(&t, &tmp_time));
-  return std::string(timestr);
+  return worker->date;
 }
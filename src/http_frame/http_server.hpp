@@ -2,19 +2,28 @@
 #define _HTTP_SERVER_HPP
 #include <sys/epoll.h>
 #include <pthread.h>
+#include <time.h>
 #include <string>
+#include <map>
 #include "server_handler.hpp"
+#include "http_request.hpp"
+#include "../looka_output_buffer.hpp"
 
 #define HTTP_INVALID_FD         -1
 #define HTTP_MAX_FD             1024
-#define HTTP_READ_BUF_SIZE      1024
-#define HTTP_READ_TIMEOUT       50
-#define HTTP_WRITE_TIMEOUT      50
-#define HTTP_HEADER_MAX_LENGTH  1024
+#define HTTP_READ_BUF_SIZE      4096
+#define HTTP_READ_TIMEOUT       5
+#define HTTP_HEADER_MAX_LENGTH  (64 * 1024)
+#define HTTP_CONTENT_MAX_LENGTH (1024 * 1024)
+// unparsed bytes a connection buffers, room for the largest request
+#define HTTP_READ_BUF_MAX \
+  (HTTP_HEADER_MAX_LENGTH + HTTP_CONTENT_MAX_LENGTH)
+#define HTTP_IDLE_TIMEOUT       60
+#define HTTP_WRITE_IOV_NUM      64
 
 #define SOCK_SEND_BUF_SIZE      (20 * 1024 * 1024)
 #define SOCK_RECV_BUF_SIZE      (20 * 1024 * 1024)
- 
+
 
 class HttpReply;
 
@@ -28,45 +37,116 @@ public:
   int Stop();
   int SetServerHandler(ServerHandler* h);
   int SetServerName(const std::string& server_name);
+  // Seconds a kept alive connection may wait for its next request.
+  int SetIdleTimeout(int seconds);
+  // Seconds a request may take to arrive once it started, and a reply
+  // may go without any of it taken by the client.
+  int SetReadTimeout(int seconds);
 
 private:
-  struct Buffer{
-    std::string read_buf[2];
+  enum ConnectionState {
+    CONN_READING = 0,
+    CONN_WRITING,
+  };
+
+  // A connection and the request it is at. Requests are read into one
+  // buffer that is kept across requests, pipelined ones follow each
+  // other in it.
+  struct Connection {
+    ConnectionState state;
+    std::string read_buf;
+    // start of the current request in read_buf
+    size_t request_start;
+    // where the search for the end of the header goes on
+    size_t scan_pos;
+    // end of the header of the current request, 0 if not seen yet
+    size_t header_end;
+    size_t content_length;
+    HttpRequest request;
+
+    // a reply goes out as its header block and the chunks of its body
+    // with writev, the body is the one the handler made, it is never
+    // copied. A streamed body goes out a part at a time in the chunked
+    // encoding, write_header is then the size line of the part.
+    std::string write_header;
+    LookaOutputBuffer write_body;
+    std::shared_ptr<HttpBodyStream> write_stream;
+    // bytes of the part written so far, over both
+    size_t write_pos;
+    bool keep_alive;
+    // the client shut down its side, close once the replies are out
+    bool peer_closed;
+    // what epoll waits for, it is not read while a reply is going out
+    uint32_t events;
+
+    // when the connection got idle, started a request or a reply, or
+    // last got a part of its reply out
+    time_t last_active;
+
+    Connection():
+      state(CONN_READING), request_start(0), scan_pos(0), header_end(0),
+      content_length(0), write_pos(0), keep_alive(false), peer_closed(false),
+      events(0), last_active(0) {
+    }
+  };
+
+  // A worker thread serves the connections it accepted itself with an
+  // epoll instance of its own, nothing is shared with the other workers.
+  // A timerfd wakes it up every second to enforce the deadlines.
+  struct Worker {
+    HttpServer* server;
+    pthread_t thread;
+    int epoll_fd;
+    int listen_fd;
+    int timer_fd;
+    // kept open to be given up when accept runs out of fds
+    int spare_fd;
+    struct epoll_event events[HTTP_MAX_FD];
+    std::map<int, Connection> connections;
+    // the Date header value, made once a second
+    time_t date_time;
+    std::string date;
   };
 
 private:
   static void* Routine(void* arg);
-  int Run();
-
-  int AddEvent(int fd);
-  int DelEvent(int fd);
+  int Run(Worker* worker);
+  int AcceptConnections(Worker* worker);
+  int ServeConnection(Worker* worker, int fd, Connection& conn);
+  int ReadAvailable(int fd, Connection& conn, time_t now);
+  int NextRequest(Connection& conn, HttpReply& reply);
+  int StartReply(Worker* worker, Connection& conn, HttpReply& reply,
+    time_t now);
+  int WriteReply(int fd, Connection& conn, time_t now);
+  int NextPart(Connection& conn);
+  int CloseConnection(Worker* worker, int fd);
+  int CloseExpiredConnections(Worker* worker, time_t now);
+
+  int AddEvent(int epoll_fd, int fd, uint32_t events);
+  int ModEvent(int epoll_fd, int fd, uint32_t events);
+  int DelEvent(int epoll_fd, int fd);
+  int WaitFor(Worker* worker, int fd, Connection& conn, uint32_t events);
   int SetSocket(int fd);
   int CreateEpoll(int& fd, int max_fd);
-  int CreateListen(int& fd, int max_fd);
-  int HandleRequest(int fd, HttpReply& reply);
-  int SendReply(int fd, HttpReply& reply);
-
-  int ReadHttpHeaderTimeout(int fd, Buffer& buffer, timeval* timeout);
-  int ReadHttpContentTimeout(int fd, Buffer& buffer, int len, timeval* timeout);
+  int CreateListen(int& fd, int max_fd, bool reuse_port);
+  int CreateTimer(int& fd);
+  int HandleRequest(HttpRequest& request, HttpReply& reply);
 
-  int ReadOnceTimeout(int fd, void* buf, size_t buf_len, timeval* timeout);
-  int WriteTimeout(int fd, const void *buf, size_t buf_len, timeval *timeout);
-
-  std::string GetServerTime();
+  const std::string& GetServerTime(Worker* worker, time_t now);
 
 private:
-  int m_listen_fd;
-  int m_epoll_fd;
   unsigned short m_listen_port;
 
-  int m_epoll_ready_event_num;
-  struct epoll_event m_epoll_ready_events[HTTP_MAX_FD];
-
-  pthread_t* m_threads;
+  Worker* m_workers;
   int m_threads_num;
-  pthread_mutex_t m_epoll_mutex;
+  int m_threads_started;
+  // every worker has a listen socket of its own, else they share the one
+  // of the first worker
+  bool m_reuse_port;
 
   bool m_running;
+  int m_idle_timeout;
+  int m_read_timeout;
   ServerHandler* m_handler;
   std::string m_server_name;
 };
@@ -1,6 +1,9 @@
 #ifndef _SERVER_HANDLER_HPP
 #define _SERVER_HANDLER_HPP
+#include <memory>
 #include "http_request.hpp"
+#include "http_body_stream.hpp"
+#include "../looka_output_buffer.hpp"
 
 class ServerHandler
 {
@@ -8,9 +11,12 @@ public:
   ServerHandler() {};
   virtual ~ServerHandler() {};
 
+  // The reply is appended to reply, it is sent from there as it is. A
+  // handler may set stream instead, the whole body then comes from it.
   virtual bool Process(
     const HttpRequest& request,
-    std::string& reply,
+    LookaOutputBuffer& reply,
+    std::shared_ptr<HttpBodyStream>& stream,
     std::string& extension) = 0;
 };
 
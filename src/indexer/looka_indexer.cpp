@@ -35,23 +35,27 @@ int LookaIndexer::DoIndex()
     _ERROR_RETURN(-1, "[sql-failed] [errstr %s]", mysql->SqlError().c_str());
   }
 
-  LookaInverter<Token, DocInvert*>* inverter =
-    new LookaInverter<Token, DocInvert*>();
-  if (!inverter)
-    _ERROR_RETURN(-1, "create inverter failed");
+  LookaPostings* postings = new LookaPostings();
+  if (!postings)
+    _ERROR_RETURN(-1, "create postings failed");
   
-  std::vector<DocAttr*>* summary = new std::vector<DocAttr*>();
-  if (!summary)
-    _ERROR_RETURN(-1, "create summary failed");
+  LookaAttributes* attributes = new LookaAttributes();
+  if (!attributes)
+    _ERROR_RETURN(-1, "create attributes failed");
+
+  LookaNorms* norms = new LookaNorms();
+  if (!norms)
+    _ERROR_RETURN(-1, "create norms failed");
 
   LookaIndexWriter* writer = new LookaIndexWriter();
   if (!writer)
     _ERROR_RETURN(-1, "create indexwriter failed");
 
-  AttrNames* uint_names   = CreateAttrNames(m_source_cfg->sql_attr_uint);
-  AttrNames* float_names  = CreateAttrNames(m_source_cfg->sql_attr_float);
-  AttrNames* multi_names  = CreateAttrNames(m_source_cfg->sql_attr_multi);
-  AttrNames* string_names = CreateAttrNames(m_source_cfg->sql_attr_string);
+  attributes->SetNames(ATTR_TYPE_UINT, m_source_cfg->sql_attr_uint);
+  attributes->SetNames(ATTR_TYPE_FLOAT, m_source_cfg->sql_attr_float);
+  attributes->SetNames(ATTR_TYPE_MULTI, m_source_cfg->sql_attr_multi);
+  attributes->SetNames(ATTR_TYPE_STRING, m_source_cfg->sql_attr_string);
+  norms->SetFieldNum(m_source_cfg->sql_field_string.size());
 
   _INFO("indexing:%s start...", m_index_cfg->mSectionName.c_str());
   {
@@ -71,7 +75,7 @@ int LookaIndexer::DoIndex()
       if (CheckFields(m_source_cfg->sql_attr_string, fn)) break;
       if (CheckFields(m_source_cfg->sql_field_string, fn)) break;
 
-      ProcessDoc(ldocid++, fs, seg, inverter, summary);
+      ProcessDoc(ldocid++, fs, seg, postings, attributes, norms);
 
       if (ldocid % 1000 == 0) {
         int waste_time = WASTE_TIME_MS(start);
@@ -80,39 +84,27 @@ int LookaIndexer::DoIndex()
     }
 
     // write index
-    writer->WriteIndexToFile(m_index_cfg->index_file, inverter);
+    writer->WriteIndexToFile(m_index_cfg->index_file, postings, norms);
     // write summary
     writer->WriteSummaryToFile(
-      m_index_cfg->summary_file_uint, summary, uint_names, ATTR_TYPE_UINT);
+      m_index_cfg->summary_file_uint, attributes, ATTR_TYPE_UINT);
     writer->WriteSummaryToFile(
-      m_index_cfg->summary_file_float, summary, float_names, ATTR_TYPE_FLOAT);
+      m_index_cfg->summary_file_float, attributes, ATTR_TYPE_FLOAT);
     writer->WriteSummaryToFile(
-      m_index_cfg->summary_file_multi, summary, multi_names, ATTR_TYPE_MULTI);
+      m_index_cfg->summary_file_multi, attributes, ATTR_TYPE_MULTI);
     writer->WriteSummaryToFile(
-      m_index_cfg->summary_file_string, summary, string_names, ATTR_TYPE_STRING);
+      m_index_cfg->summary_file_string, attributes, ATTR_TYPE_STRING);
 
     int waste_time = WASTE_TIME_MS(start);
     _INFO("[docnum %d] [cost %dms]", ldocid, waste_time);
   }
 
   // free memery
-  for (unsigned int i=0; i<summary->size(); i++)
-    delete (*summary)[i];
-
-  std::vector<Token> tokens;
-  inverter->GetKeys(tokens);
-  for (unsigned int i=0; i<tokens.size(); i++) {
-    Token& t = tokens[i];
-    std::vector<DocInvert*>* doclist;
-    inverter->GetItems(t, doclist);
-    for (unsigned int j=0; j<doclist->size(); j++)
-      free((*doclist)[j]);
-  }
-
   delete mysql;
   delete seg;
-  delete inverter;
-  delete summary;
+  delete postings;
+  delete attributes;
+  delete norms;
   delete writer;
   return 0;
 }
@@ -121,19 +113,21 @@ bool LookaIndexer::ProcessDoc(
   LocalDocID ldocid,
   const std::vector<MysqlField>& doc_fields,
   LookaSegmenter* seg,
-  LookaInverter<Token, DocInvert*>* inverter,
-  std::vector<DocAttr*>* summary)
+  LookaPostings* postings,
+  LookaAttributes* attributes,
+  LookaNorms* norms)
 {
   if (!seg)
     return false;
 
-  DocAttr* attr = new DocAttr;
-
   std::vector<uint32_t> uv(m_source_cfg->sql_attr_uint.size());
-  std::vector<uint32_t> mv(m_source_cfg->sql_attr_multi.size());
+  std::vector<std::vector<uint32_t> > mv(m_source_cfg->sql_attr_multi.size());
   std::vector<float>    fv(m_source_cfg->sql_attr_float.size());
   std::vector<std::string> sv(m_source_cfg->sql_attr_string.size());
+  std::vector<uint32_t> lengths(m_source_cfg->sql_field_string.size());
   std::map<Token, LookaSimpleInverter<FieldID, uint8_t>*> tokenHits;
+  std::vector<SegmentSpan> segspans;
+  std::string segtoken;
   for (unsigned int i=0; i<doc_fields.size(); i++)
   {
     int field_index;
@@ -148,13 +142,12 @@ bool LookaIndexer::ProcessDoc(
       sv[field_index] = f.value;
       //sv.push_back(f.value);
 
-    // todo: fix multi value
     if (IsInFields(f.name, m_source_cfg->sql_attr_multi, field_index)) {
       std::vector<std::string> v;
       splitString(f.value, ',', v);
       for (unsigned int j=0; j<v.size(); j++)
         if (!(trim(v[j])).empty())
-          mv.push_back((uint32_t)atoi(v[j].c_str()));
+          mv[field_index].push_back((uint32_t)atoi(v[j].c_str()));
     }
 
     if (!IsInFields(f.name, m_source_cfg->sql_field_string, field_index))
@@ -162,20 +155,22 @@ bool LookaIndexer::ProcessDoc(
     FieldID field_id = static_cast<FieldID>(field_index);
 
     // do segment
-    std::vector<SegmentToken> segtokens;
-    std::string segvalue = f.value;
-    if (!seg->Segment(segvalue, segtokens)) continue;
+    segspans.clear();
+    if (!seg->Segment(f.value.data(), f.value.length(), segspans)) continue;
+    lengths[field_index] = segspans.size();
 
-    for (unsigned int j=0; j<segtokens.size(); j++) {
-      Token t(segtokens[j].str);
+    for (unsigned int j=0; j<segspans.size(); j++) {
+      segtoken.assign(f.value, segspans[j].offset, segspans[j].len);
+      Token t(segtoken);
       if (tokenHits.find(t) == tokenHits.end())
         tokenHits.insert(
           std::make_pair(t, new LookaSimpleInverter<FieldID, uint8_t>()));
       LookaSimpleInverter<FieldID, uint8_t>* &fieldHits = tokenHits[t];
-      fieldHits->Add(field_id, segtokens[j].pos);
+      fieldHits->Add(field_id, segspans[j].pos);
     }
   }
 
+  std::vector<char> hit_buf;
   std::map<Token, LookaSimpleInverter<FieldID, uint8_t>*>::iterator it;
   for (it = tokenHits.begin(); it != tokenHits.end(); ++it)
   {
@@ -191,16 +186,10 @@ bool LookaIndexer::ProcessDoc(
       alloc_hit_size += sizeof(HitPos) + count * sizeof(uint8_t);
     }
 
-    int32_t doc_size = sizeof(DocInvert) + alloc_hit_size;
-    DocInvert* invert = (DocInvert*)malloc(doc_size);
-    invert->local_id = ldocid;
-    invert->hits_size = alloc_hit_size;
-
-    char* ptr = (char*)(invert->hits);
+    hit_buf.resize(alloc_hit_size);
+    char* ptr = &hit_buf[0];
     for (uint32_t i=0; i<field_num; i++)
     {
-      if ((ptr - (char*)invert) > doc_size)
-        break;
       std::vector<uint8_t>* pos_v;
       uint32_t count = fieldHits->GetItems(field_id[i], pos_v);
 
@@ -212,51 +201,13 @@ bool LookaIndexer::ProcessDoc(
       ptr += sizeof(HitPos) + count * sizeof(uint8_t);
     }
 
-    inverter->Add(t, invert);
+    postings->GetOrCreate(t)->Add(
+      ldocid, (HitPos*)(&hit_buf[0]), alloc_hit_size);
     delete fieldHits;
   }
 
-  AttrUint* ua;
-  AttrFloat* fa;
-  AttrMulti* ma;
-  AttrString* sa;
-
-  ua = (AttrUint*)malloc(sizeof(AttrUint) + uv.size() * sizeof(uint32_t));
-  fa = (AttrFloat*)malloc(sizeof(AttrFloat) + fv.size() * sizeof(float));
-  ma = (AttrMulti*)malloc(sizeof(AttrMulti) + mv.size() * sizeof(uint32_t));
-
-  int s_alloc_size = sizeof(AttrString) + sv.size() * sizeof(uint32_t);
-  for (unsigned int i=0; i<sv.size(); i++)
-    s_alloc_size += sv[i].length() + 1;
-  sa = (AttrString*)malloc(s_alloc_size);
-
-  ua->size = uv.size();
-  fa->size = fv.size();
-  ma->size = mv.size();
-  sa->size = sv.size();
-
-  for (unsigned int i=0; i<uv.size(); i++)
-    ua->data[i] = uv[i];
-  for (unsigned int i=0; i<fv.size(); i++)
-    fa->data[i] = fv[i];
-  for (unsigned int i=0; i<mv.size(); i++)
-    ma->data[i] = mv[i];
-
-  int cur_pos = 0;
-  int offset = sv.size() * sizeof(uint32_t);
-  for (unsigned int i=0; i<sv.size(); i++) {
-    sa->len[i] = sv[i].length();
-    int abs_pos = offset + cur_pos;
-    memcpy(sa->data + abs_pos, &(sv[i][0]), sv[i].length());
-    cur_pos += sv[i].length() + 1;
-  }
-
-  attr->u = ua;
-  attr->f = fa;
-  attr->m = ma;
-  attr->s = sa;
-
-  summary->push_back(attr);
+  attributes->AddDoc(uv, fv, mv, sv);
+  norms->AddDoc(lengths);
 
   return true;
 }
@@ -303,25 +254,3 @@ bool LookaIndexer::IsInFields(
   index = std::distance(fields.begin(), it);
   return true;
 }
-
-AttrNames* LookaIndexer::CreateAttrNames(const std::vector<std::string>& attrs)
-{
-  AttrNames* a = NULL;
-
-  int s_alloc_size = sizeof(AttrNames) + attrs.size() * sizeof(uint32_t);
-  for (unsigned int i=0; i<attrs.size(); i++)
-    s_alloc_size += attrs[i].length() + 1;
-  a = (AttrNames*)malloc(s_alloc_size);
-  a->size = attrs.size();
-  
-  int cur_pos = 0;
-  int offset = attrs.size() * sizeof(uint32_t);
-  for (unsigned int i=0; i<attrs.size(); i++) {
-    a->len[i] = attrs[i].length();
-    int abs_pos = offset + cur_pos;
-    memcpy(a->data + abs_pos, &(attrs[i][0]), attrs[i].length());
-    cur_pos += attrs[i].length() + 1;
-  }
-
-  return a;
-}
@@ -7,6 +7,9 @@
 #include "../looka_config_source.hpp"
 #include "../looka_segmenter.hpp"
 #include "../looka_inverter.hpp"
+#include "../looka_postings.hpp"
+#include "../looka_attributes.hpp"
+#include "../looka_norms.hpp"
 #include "../looka_types.hpp"
 
 class LookaIndexer
@@ -30,10 +33,9 @@ private:
     LocalDocID ldocid,
     const std::vector<MysqlField>& doc_fields,
     LookaSegmenter* seg,
-    LookaInverter<Token, DocInvert*>* inverter,
-    std::vector<DocAttr*>* summary);
-
-  AttrNames* CreateAttrNames(const std::vector<std::string>& attrs);
+    LookaPostings* postings,
+    LookaAttributes* attributes,
+    LookaNorms* norms);
 
 private:
   LookaConfigSource* m_source_cfg;
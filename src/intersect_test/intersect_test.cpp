@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "../looka_intersect_kernel.hpp"
+
+// Every kernel the cpu runs is checked against std::set_intersection on
+// lists made to hit the vector loops and the scalar tails.
+
+struct Kernel {
+  const char* name;
+  IntersectFunc func;
+};
+
+static std::vector<Kernel> GetKernels()
+{
+  std::vector<Kernel> kernels;
+  Kernel scalar = {"scalar", IntersectScalar};
+  kernels.push_back(scalar);
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.1")) {
+    Kernel sse41 = {"sse4.1", IntersectSSE41};
+    kernels.push_back(sse41);
+  } else {
+    printf("[skip sse4.1]\n");
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    Kernel avx2 = {"avx2", IntersectAVX2};
+    kernels.push_back(avx2);
+  } else {
+    printf("[skip avx2]\n");
+  }
+#endif
+  return kernels;
+}
+
+// size sorted distinct ids, gap apart at most
+static std::vector<LocalDocID> RandomList(uint32_t size, uint32_t gap)
+{
+  std::vector<LocalDocID> ids;
+  LocalDocID id = rand() % gap;
+  for (uint32_t i=0; i<size; i++) {
+    ids.push_back(id);
+    id += 1 + rand() % gap;
+  }
+  return ids;
+}
+
+static std::vector<LocalDocID> Range(uint32_t begin, uint32_t end,
+  uint32_t step)
+{
+  std::vector<LocalDocID> ids;
+  for (uint64_t id=begin; id<end; id+=step)
+    ids.push_back(id);
+  return ids;
+}
+
+static int Check(const std::vector<Kernel>& kernels, const std::string& name,
+  const std::vector<LocalDocID>& a, const std::vector<LocalDocID>& b)
+{
+  std::vector<LocalDocID> expect;
+  std::set_intersection(a.begin(), a.end(), b.begin(), b.end(),
+    std::back_inserter(expect));
+
+  int failed = 0;
+  std::vector<LocalDocID> out(
+    std::min(a.size(), b.size()) + kIntersectPadding);
+  for (size_t k=0; k<kernels.size(); k++) {
+    // both orders, the kernels advance the two sides differently
+    for (int swap=0; swap<2; swap++) {
+      const std::vector<LocalDocID>& x = swap ? b : a;
+      const std::vector<LocalDocID>& y = swap ? a : b;
+      std::fill(out.begin(), out.end(), 0xFFFFFFFF);
+      uint32_t n = kernels[k].func(
+        x.empty() ? NULL : &x[0], x.size(),
+        y.empty() ? NULL : &y[0], y.size(), &out[0]);
+      if (n != expect.size() ||
+          !std::equal(expect.begin(), expect.end(), out.begin())) {
+        printf("[FAIL] [%s] [%s] [a %zu] [b %zu] [expect %zu] [got %u]\n",
+          kernels[k].name, name.c_str(), x.size(), y.size(),
+          expect.size(), n);
+        failed++;
+      }
+    }
+  }
+  return failed;
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<Kernel> kernels = GetKernels();
+  std::vector<LocalDocID> empty;
+  int failed = 0;
+
+  failed += Check(kernels, "both empty", empty, empty);
+  failed += Check(kernels, "one empty", empty, Range(0, 100, 1));
+  failed += Check(kernels, "one id", Range(7, 8, 1), Range(0, 100, 1));
+
+  // lengths around the vector widths
+  for (uint32_t n=1; n<=33; n++) {
+    char name[64];
+    snprintf(name, sizeof(name), "identical %u", n);
+    failed += Check(kernels, name, Range(0, n, 1), Range(0, n, 1));
+    snprintf(name, sizeof(name), "disjoint %u", n);
+    failed += Check(kernels, name, Range(0, 2 * n, 2), Range(1, 2 * n, 2));
+    snprintf(name, sizeof(name), "apart %u", n);
+    failed += Check(kernels, name, Range(0, n, 1), Range(n, 2 * n, 1));
+    snprintf(name, sizeof(name), "every third %u", n);
+    failed += Check(kernels, name, Range(0, 3 * n, 1), Range(0, 3 * n, 3));
+  }
+
+  // the largest ids, the scalar tail must not be taken for a sentinel
+  failed += Check(kernels, "top ids", Range(0xFFFFFF00, 0xFFFFFFFE, 1),
+    Range(0xFFFFFF00, 0xFFFFFFFE, 3));
+
+  srand(argc > 1 ? atoi(argv[1]) : 20161017);
+  for (int round=0; round<2000; round++) {
+    uint32_t a_size = rand() % 200;
+    uint32_t b_size = rand() % (round % 10 == 0 ? 5000 : 200);
+    // a small gap makes many matches, a large one few
+    uint32_t gap = 1 + rand() % 8;
+    char name[64];
+    snprintf(name, sizeof(name), "random %d", round);
+    failed += Check(kernels, name,
+      RandomList(a_size, gap), RandomList(b_size, gap));
+  }
+
+  printf("[kernels %zu] [failed %d]\n", kernels.size(), failed);
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,252 @@
+#include <string.h>
+#include <fstream>
+#include "looka_attributes.hpp"
+#include "looka_log.hpp"
+
+// Attribute file layout: a header, the attribute names as length and
+// bytes, a directory with the file offset of every column, then the
+// columns. Columns start on 8 byte boundaries so they map as arrays.
+static const uint32_t kAttrFileMagic   = 0x41434C; // "LCA"
+static const uint32_t kAttrFileVersion = 1;
+static const uint64_t kColumnAlign     = 8;
+
+struct AttrFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t type;
+  uint32_t doc_num;
+  uint32_t attr_num;
+  uint32_t names_size;
+};
+
+static bool IsVarColumn(DocAttrType type)
+{
+  return type == ATTR_TYPE_MULTI || type == ATTR_TYPE_STRING;
+}
+
+static uint64_t AlignColumn(uint64_t offset)
+{
+  return (offset + kColumnAlign - 1) / kColumnAlign * kColumnAlign;
+}
+
+LookaAttributes::LookaAttributes(): m_doc_num(0)
+{
+}
+
+LookaAttributes::~LookaAttributes()
+{
+}
+
+void LookaAttributes::SetNames(
+  DocAttrType type, const std::vector<std::string>& names)
+{
+  m_names[type] = names;
+  m_data[type].assign(names.size(), std::vector<char>());
+  m_offsets[type].assign(names.size(), std::vector<uint32_t>());
+  if (IsVarColumn(type))
+    for (size_t i=0; i<names.size(); i++)
+      m_offsets[type][i].push_back(0);
+}
+
+template <typename T>
+static void AppendValue(std::vector<char>& data, const T& v)
+{
+  const char* p = reinterpret_cast<const char*>(&v);
+  data.insert(data.end(), p, p + sizeof(T));
+}
+
+void LookaAttributes::AddDoc(
+  const std::vector<uint32_t>& uv,
+  const std::vector<float>& fv,
+  const std::vector<std::vector<uint32_t> >& mv,
+  const std::vector<std::string>& sv)
+{
+  for (size_t i=0; i<m_data[ATTR_TYPE_UINT].size(); i++)
+    AppendValue(m_data[ATTR_TYPE_UINT][i], i < uv.size() ? uv[i] : 0);
+  for (size_t i=0; i<m_data[ATTR_TYPE_FLOAT].size(); i++)
+    AppendValue(m_data[ATTR_TYPE_FLOAT][i], i < fv.size() ? fv[i] : 0.0f);
+
+  for (size_t i=0; i<m_data[ATTR_TYPE_MULTI].size(); i++) {
+    std::vector<char>& data = m_data[ATTR_TYPE_MULTI][i];
+    if (i < mv.size())
+      for (size_t j=0; j<mv[i].size(); j++)
+        AppendValue(data, mv[i][j]);
+    m_offsets[ATTR_TYPE_MULTI][i].push_back(data.size() / sizeof(uint32_t));
+  }
+  for (size_t i=0; i<m_data[ATTR_TYPE_STRING].size(); i++) {
+    std::vector<char>& data = m_data[ATTR_TYPE_STRING][i];
+    if (i < sv.size())
+      data.insert(data.end(), sv[i].begin(), sv[i].end());
+    m_offsets[ATTR_TYPE_STRING][i].push_back(data.size());
+  }
+  m_doc_num++;
+}
+
+bool LookaAttributes::Write(DocAttrType type, const std::string& file) const
+{
+  std::ofstream f(file.c_str(), std::ios::binary);
+  if (!f) {
+    _ERROR("[cannot open file %s]", file.c_str());
+    return false;
+  }
+
+  const std::vector<std::string>& names = m_names[type];
+  AttrFileHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kAttrFileMagic;
+  header.version = kAttrFileVersion;
+  header.type = type;
+  header.doc_num = m_doc_num;
+  header.attr_num = names.size();
+  for (size_t i=0; i<names.size(); i++)
+    header.names_size += sizeof(uint32_t) + names[i].length();
+
+  // lay out the columns behind the header, names and directory
+  std::vector<uint64_t> directory(names.size());
+  uint64_t offset = sizeof(header) + header.names_size;
+  offset = AlignColumn(offset) + names.size() * sizeof(uint64_t);
+  for (size_t i=0; i<names.size(); i++) {
+    offset = AlignColumn(offset);
+    directory[i] = offset;
+    offset += m_offsets[type][i].size() * sizeof(uint32_t) + m_data[type][i].size();
+  }
+
+  const char padding[kColumnAlign] = {0};
+  f.write((char*)&header, sizeof(header));
+  for (size_t i=0; i<names.size(); i++) {
+    uint32_t len = names[i].length();
+    f.write((char*)&len, sizeof(len));
+    f.write(names[i].data(), len);
+  }
+  uint64_t pos = sizeof(header) + header.names_size;
+  f.write(padding, AlignColumn(pos) - pos);
+  if (!directory.empty())
+    f.write((char*)&directory[0], directory.size() * sizeof(uint64_t));
+  pos = AlignColumn(pos) + directory.size() * sizeof(uint64_t);
+
+  for (size_t i=0; i<names.size(); i++) {
+    f.write(padding, directory[i] - pos);
+    const std::vector<uint32_t>& offsets = m_offsets[type][i];
+    const std::vector<char>& data = m_data[type][i];
+    if (!offsets.empty())
+      f.write((char*)&offsets[0], offsets.size() * sizeof(uint32_t));
+    if (!data.empty())
+      f.write(&data[0], data.size());
+    pos = directory[i] + offsets.size() * sizeof(uint32_t) + data.size();
+  }
+
+  bool ok = !f.fail();
+  f.close();
+  if (!ok)
+    _ERROR("[write attribute file %s failed]", file.c_str());
+  return ok;
+}
+
+bool LookaAttributes::Map(DocAttrType type, const std::string& file)
+{
+  LookaMmap& mapping = m_files[type];
+  if (!mapping.Open(file))
+    return false;
+
+  const char* data = mapping.Data();
+  uint64_t size = mapping.Size();
+  const AttrFileHeader* header = reinterpret_cast<const AttrFileHeader*>(data);
+  if (size < sizeof(AttrFileHeader) ||
+      header->magic != kAttrFileMagic ||
+      header->version != kAttrFileVersion ||
+      header->type != (uint32_t)type ||
+      sizeof(AttrFileHeader) + (uint64_t)header->names_size > size) {
+    _ERROR("[bad attribute file %s]", file.c_str());
+    mapping.Close();
+    return false;
+  }
+
+  bool mapped = false;
+  for (uint32_t t=0; t<kAttrTypeNum; t++)
+    mapped |= (t != (uint32_t)type && m_files[t].Data() != NULL);
+  if (mapped && header->doc_num != m_doc_num) {
+    _ERROR("[doc count %u of %s does not match %u]",
+      header->doc_num, file.c_str(), m_doc_num);
+    mapping.Close();
+    return false;
+  }
+  m_doc_num = header->doc_num;
+
+  // attribute names
+  std::vector<std::string>& names = m_names[type];
+  names.clear();
+  const char* p = data + sizeof(AttrFileHeader);
+  const char* names_end = p + header->names_size;
+  for (uint32_t i=0; i<header->attr_num; i++) {
+    uint32_t len;
+    if (p + sizeof(len) > names_end)
+      break;
+    memcpy(&len, p, sizeof(len));
+    p += sizeof(len);
+    if (p + len > names_end)
+      break;
+    names.push_back(std::string(p, len));
+    p += len;
+  }
+
+  uint64_t dir_offset = AlignColumn(sizeof(AttrFileHeader) + header->names_size);
+  if (names.size() != header->attr_num ||
+      dir_offset + header->attr_num * sizeof(uint64_t) > size) {
+    _ERROR("[bad attribute names] [file %s]", file.c_str());
+    mapping.Close();
+    return false;
+  }
+
+  // columns
+  const uint64_t* directory = reinterpret_cast<const uint64_t*>(data + dir_offset);
+  uint64_t offsets_size = IsVarColumn(type) ? (m_doc_num + 1) * sizeof(uint32_t) : 0;
+  uint64_t value_size = type == ATTR_TYPE_STRING ? 1 : sizeof(uint32_t);
+  std::vector<AttrColumn>& columns = m_columns[type];
+  columns.assign(header->attr_num, AttrColumn());
+  for (uint32_t i=0; i<header->attr_num; i++) {
+    AttrColumn& c = columns[i];
+    uint64_t begin = directory[i];
+    if (begin % kColumnAlign != 0 || begin + offsets_size > size) {
+      _ERROR("[bad attribute column %u] [file %s]", i, file.c_str());
+      mapping.Close();
+      return false;
+    }
+    c.offsets = IsVarColumn(type) ? reinterpret_cast<const uint32_t*>(data + begin) : NULL;
+    c.data = data + begin + offsets_size;
+    uint64_t values = IsVarColumn(type) ? c.offsets[m_doc_num] : m_doc_num;
+    if (begin + offsets_size + values * value_size > size) {
+      _ERROR("[bad attribute column %u] [file %s]", i, file.c_str());
+      mapping.Close();
+      return false;
+    }
+  }
+  return true;
+}
+
+bool LookaAttributes::GetAttrIndex(
+  const std::string& name, DocAttrType& type, int& index) const
+{
+  // a name shared by several types resolves to the last one, like the
+  // lookup over the attribute name tables did
+  bool found = false;
+  for (uint32_t t=0; t<kAttrTypeNum; t++) {
+    const std::vector<std::string>& names = m_names[t];
+    for (size_t i=0; i<names.size(); i++) {
+      if (names[i] == name) {
+        type = static_cast<DocAttrType>(t);
+        index = static_cast<int>(i);
+        found = true;
+        break;
+      }
+    }
+  }
+  return found;
+}
+
+const uint32_t* LookaAttributes::GetMulti(
+  int index, LocalDocID id, uint32_t& size) const
+{
+  const AttrColumn& c = m_columns[ATTR_TYPE_MULTI][index];
+  size = c.offsets[id + 1] - c.offsets[id];
+  return reinterpret_cast<const uint32_t*>(c.data) + c.offsets[id];
+}
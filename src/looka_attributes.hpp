@@ -0,0 +1,70 @@
+#ifndef _LOOKA_ATTRIBUTES_HPP
+#define _LOOKA_ATTRIBUTES_HPP
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "looka_types.hpp"
+#include "looka_mmap.hpp"
+#include "looka_string_piece.hpp"
+
+const uint32_t kAttrTypeNum = ATTR_TYPE_STRING + 1;
+
+// One attribute of every doc. A uint or float column is a plain array
+// indexed by doc id, a multi or string column holds doc_num + 1 offsets
+// into its values, the values of doc i are [offsets[i], offsets[i + 1]).
+struct AttrColumn {
+  const uint32_t* offsets;
+  const char*     data;
+};
+
+// Column store of the doc attributes, one file per attribute type
+// (.lcu/.lcf/.lcm/.lcs). The indexer fills it with AddDoc() and writes
+// it with Write(), searchd maps the written files with Map() and reads
+// the columns in place.
+class LookaAttributes
+{
+public:
+  LookaAttributes();
+  virtual ~LookaAttributes();
+
+  void SetNames(DocAttrType type, const std::vector<std::string>& names);
+  void AddDoc(
+    const std::vector<uint32_t>& uv,
+    const std::vector<float>& fv,
+    const std::vector<std::vector<uint32_t> >& mv,
+    const std::vector<std::string>& sv);
+  bool Write(DocAttrType type, const std::string& file) const;
+
+  bool Map(DocAttrType type, const std::string& file);
+
+  uint32_t GetDocNum() const {return m_doc_num;}
+  const std::vector<std::string>& GetNames(DocAttrType type) const {return m_names[type];}
+  bool GetAttrIndex(const std::string& name, DocAttrType& type, int& index) const;
+
+  const uint32_t* GetUintColumn(int index) const {
+    return reinterpret_cast<const uint32_t*>(m_columns[ATTR_TYPE_UINT][index].data);
+  }
+  const float* GetFloatColumn(int index) const {
+    return reinterpret_cast<const float*>(m_columns[ATTR_TYPE_FLOAT][index].data);
+  }
+  uint32_t GetUint(int index, LocalDocID id) const {return GetUintColumn(index)[id];}
+  float GetFloat(int index, LocalDocID id) const {return GetFloatColumn(index)[id];}
+  const uint32_t* GetMulti(int index, LocalDocID id, uint32_t& size) const;
+  // Slice of the mapped column, valid as long as the attributes are.
+  StringPiece GetString(int index, LocalDocID id) const {
+    const AttrColumn& c = m_columns[ATTR_TYPE_STRING][index];
+    return StringPiece(c.data + c.offsets[id], c.offsets[id + 1] - c.offsets[id]);
+  }
+
+private:
+  std::vector<std::string> m_names[kAttrTypeNum];
+  std::vector<AttrColumn>  m_columns[kAttrTypeNum];
+  LookaMmap m_files[kAttrTypeNum];
+  uint32_t  m_doc_num;
+
+  // index time buffers, per type one offsets and one data array per column
+  std::vector<std::vector<uint32_t> > m_offsets[kAttrTypeNum];
+  std::vector<std::vector<char> >     m_data[kAttrTypeNum];
+};
+
+#endif //_LOOKA_ATTRIBUTES_HPP
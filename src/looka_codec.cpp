@@ -0,0 +1,146 @@
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "looka_codec.hpp"
+
+// A packed block is one width byte followed by 4 lanes of width words,
+// word k of lane j is stored at k * 4 + j. Lane j holds the deltas
+// j, j + 4, j + 8, ... so unpacking all lanes at once writes the deltas
+// back in order.
+static const uint32_t kLaneNum  = 4;
+static const uint32_t kLaneSize = kPostingBlockSize / kLaneNum;
+
+uint32_t BitWidth(uint32_t v)
+{
+  return v == 0 ? 0 : 32 - __builtin_clz(v);
+}
+
+uint32_t PackBlock(const uint32_t* in, std::vector<uint8_t>& out)
+{
+  uint32_t max = 0;
+  for (uint32_t i=0; i<kPostingBlockSize; i++)
+    max |= in[i];
+  uint32_t b = BitWidth(max);
+
+  uint32_t words[kLaneNum * 32];
+  memset(words, 0, sizeof(words));
+  for (uint32_t j=0; j<kLaneNum; j++) {
+    uint32_t bitpos = 0;
+    for (uint32_t i=0; i<kLaneSize; i++) {
+      uint32_t v = in[i * kLaneNum + j];
+      uint32_t w = bitpos >> 5;
+      uint32_t s = bitpos & 31;
+      words[w * kLaneNum + j] |= v << s;
+      if (s + b > 32)
+        words[(w + 1) * kLaneNum + j] |= v >> (32 - s);
+      bitpos += b;
+    }
+  }
+
+  uint32_t bytes = b * kLaneNum * sizeof(uint32_t);
+  out.push_back(static_cast<uint8_t>(b));
+  out.insert(out.end(), (uint8_t*)words, (uint8_t*)words + bytes);
+  return bytes + 1;
+}
+
+#ifdef __SSE2__
+uint32_t UnpackBlock(const uint8_t* in, uint32_t* out)
+{
+  uint32_t b = *in++;
+  __m128i* dst = reinterpret_cast<__m128i*>(out);
+  if (b == 0) {
+    for (uint32_t i=0; i<kLaneSize; i++)
+      _mm_storeu_si128(dst + i, _mm_setzero_si128());
+    return 1;
+  }
+
+  const __m128i* src = reinterpret_cast<const __m128i*>(in);
+  const __m128i mask = _mm_set1_epi32(b == 32 ? 0xFFFFFFFF : (1U << b) - 1);
+  __m128i cur = _mm_loadu_si128(src);
+  uint32_t w = 0;
+  uint32_t s = 0;
+  for (uint32_t i=0; i<kLaneSize; i++) {
+    __m128i v = _mm_srl_epi32(cur, _mm_cvtsi32_si128(s));
+    s += b;
+    if (s >= 32) {
+      s -= 32;
+      if (++w < b) {
+        cur = _mm_loadu_si128(src + w);
+        if (s > 0)
+          v = _mm_or_si128(v, _mm_sll_epi32(cur, _mm_cvtsi32_si128(b - s)));
+      }
+    }
+    _mm_storeu_si128(dst + i, _mm_and_si128(v, mask));
+  }
+  return b * kLaneNum * sizeof(uint32_t) + 1;
+}
+
+void PrefixSum(uint32_t* data, uint32_t size, uint32_t base)
+{
+  uint32_t i = 0;
+  __m128i* p = reinterpret_cast<__m128i*>(data);
+  __m128i prev = _mm_set1_epi32(base);
+  for (; i + kLaneNum <= size; i += kLaneNum, p++) {
+    __m128i v = _mm_loadu_si128(p);
+    v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+    v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+    v = _mm_add_epi32(v, prev);
+    _mm_storeu_si128(p, v);
+    prev = _mm_shuffle_epi32(v, 0xFF);
+  }
+  uint32_t sum = _mm_cvtsi128_si32(prev);
+  for (; i < size; i++)
+    data[i] = (sum += data[i]);
+}
+#else
+uint32_t UnpackBlock(const uint8_t* in, uint32_t* out)
+{
+  uint32_t b = *in++;
+  uint32_t words[kLaneNum * 32];
+  memcpy(words, in, b * kLaneNum * sizeof(uint32_t));
+  uint32_t mask = (b == 32) ? 0xFFFFFFFF : (1U << b) - 1;
+  for (uint32_t j=0; j<kLaneNum; j++) {
+    uint32_t bitpos = 0;
+    for (uint32_t i=0; i<kLaneSize; i++) {
+      uint32_t w = bitpos >> 5;
+      uint32_t s = bitpos & 31;
+      uint32_t v = b ? words[w * kLaneNum + j] >> s : 0;
+      if (s + b > 32)
+        v |= words[(w + 1) * kLaneNum + j] << (32 - s);
+      out[i * kLaneNum + j] = v & mask;
+      bitpos += b;
+    }
+  }
+  return b * kLaneNum * sizeof(uint32_t) + 1;
+}
+
+void PrefixSum(uint32_t* data, uint32_t size, uint32_t base)
+{
+  uint32_t sum = base;
+  for (uint32_t i=0; i<size; i++)
+    data[i] = (sum += data[i]);
+}
+#endif
+
+void VByteEncode(uint32_t v, std::vector<uint8_t>& out)
+{
+  while (v >= 0x80) {
+    out.push_back(static_cast<uint8_t>(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(v));
+}
+
+uint32_t VByteDecode(const uint8_t* in, uint32_t& v)
+{
+  uint32_t n = 0;
+  uint32_t shift = 0;
+  v = 0;
+  while (in[n] & 0x80) {
+    v |= static_cast<uint32_t>(in[n++] & 0x7F) << shift;
+    shift += 7;
+  }
+  v |= static_cast<uint32_t>(in[n++]) << shift;
+  return n;
+}
@@ -0,0 +1,25 @@
+#ifndef _LOOKA_CODEC_HPP
+#define _LOOKA_CODEC_HPP
+#include <stdint.h>
+#include <vector>
+
+// Doc ids of a posting list are delta encoded in blocks of
+// kPostingBlockSize. A full block is bit-packed with the width of its
+// largest delta, four interleaved lanes so it unpacks with 128-bit
+// shifts. The last, partial block of a list is variable-byte encoded.
+const uint32_t kPostingBlockSize = 128;
+
+uint32_t BitWidth(uint32_t v);
+
+// Encode a full block of kPostingBlockSize deltas, returns bytes written.
+uint32_t PackBlock(const uint32_t* in, std::vector<uint8_t>& out);
+// Decode a full block of deltas, returns bytes consumed.
+uint32_t UnpackBlock(const uint8_t* in, uint32_t* out);
+
+void VByteEncode(uint32_t v, std::vector<uint8_t>& out);
+uint32_t VByteDecode(const uint8_t* in, uint32_t& v);
+
+// Turn deltas back into ids: out[i] = base + in[0] + ... + in[i].
+void PrefixSum(uint32_t* data, uint32_t size, uint32_t base);
+
+#endif //_LOOKA_CODEC_HPP
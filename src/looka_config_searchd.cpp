@@ -39,4 +39,11 @@ LookaConfigSearchd::LookaConfigSearchd(LookaConfigParser* lc, const std::string&
   item = "read_timeout";
   if ((read_timeout = lc->GetInt(mSectionTag, mSectionName, item, 0)) == 0)
     _ERROR_EXIT(-1, "[LookaConfigSearchd Init Error] [get %s failed]", item.c_str());
+
+  item = "result_cache_size";
+  if ((result_cache_size = lc->GetInt(mSectionTag, mSectionName, item, 0)) < 0)
+    _ERROR_EXIT(-1, "[LookaConfigSearchd Init Error] [get %s failed]", item.c_str());
+
+  item = "json_styled";
+  json_styled = lc->GetInt(mSectionTag, mSectionName, item, 0);
 }
@@ -14,6 +14,10 @@ public:
   int max_matches;
   int client_timeout;
   int read_timeout;
+  // memory budget of the result cache in MB, 0 turns it off
+  int result_cache_size;
+  // json replies indented for reading instead of compact
+  int json_styled;
   std::string searchd_log;
   std::string query_log;
   std::string pid_file;
@@ -0,0 +1,116 @@
+#include <string.h>
+#include "looka_dictionary.hpp"
+#include "looka_str2id.hpp"
+#include "looka_log.hpp"
+
+// interpolation steps before falling back to binary search, token ids
+// are hashes so a few steps usually land next to the entry
+static const uint32_t kInterpolationSteps = 4;
+static const uint32_t kInterpolationMinRange = 16;
+
+LookaDictionary::LookaDictionary():
+  m_dict(NULL), m_token_num(0), m_pool(NULL), m_pool_size(0),
+  m_postings(NULL), m_postings_size(0)
+{
+}
+
+LookaDictionary::~LookaDictionary()
+{
+}
+
+bool LookaDictionary::Load(const std::string& index_file)
+{
+  if (!m_mapping.Open(index_file))
+    return false;
+
+  const char* data = m_mapping.Data();
+  uint64_t size = m_mapping.Size();
+  const IndexFileHeader* header = reinterpret_cast<const IndexFileHeader*>(data);
+  if (size < sizeof(IndexFileHeader) ||
+      header->magic != kIndexFileMagic ||
+      header->version != kIndexFileVersion ||
+      header->file_size != size ||
+      header->dict_offset % sizeof(uint64_t) != 0 ||
+      header->dict_offset + (uint64_t)header->token_num * sizeof(IndexDictEntry) > size ||
+      header->pool_offset + header->pool_size > size ||
+      header->postings_offset > header->norms_offset ||
+      header->norms_offset % sizeof(uint64_t) != 0 ||
+      header->norms_offset > size) {
+    _ERROR("[bad index file %s]", index_file.c_str());
+    m_mapping.Close();
+    return false;
+  }
+
+  m_dict = reinterpret_cast<const IndexDictEntry*>(data + header->dict_offset);
+  m_token_num = header->token_num;
+  m_pool = data + header->pool_offset;
+  m_pool_size = header->pool_size;
+  m_postings = data + header->postings_offset;
+  m_postings_size = header->norms_offset - header->postings_offset;
+  if (!m_norms.Map(data + header->norms_offset, size - header->norms_offset)) {
+    _ERROR("[bad norms] [file %s]", index_file.c_str());
+    m_mapping.Close();
+    return false;
+  }
+  return true;
+}
+
+uint32_t LookaDictionary::LowerBound(TokenID id) const
+{
+  // the first entry with id >= the searched one is in [lo, hi]
+  uint32_t lo = 0;
+  uint32_t hi = m_token_num;
+  for (uint32_t step=0; step<kInterpolationSteps &&
+      hi - lo > kInterpolationMinRange; step++) {
+    TokenID lo_id = m_dict[lo].id;
+    TokenID hi_id = m_dict[hi - 1].id;
+    if (id <= lo_id)
+      return lo;
+    if (id > hi_id)
+      return hi;
+
+    uint32_t mid = lo + (uint32_t)(
+      (unsigned __int128)(id - lo_id) * (hi - 1 - lo) / (hi_id - lo_id));
+    if (m_dict[mid].id < id)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  while (lo < hi) {
+    uint32_t mid = lo + ((hi - lo) >> 1);
+    if (m_dict[mid].id < id)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+const IndexDictEntry* LookaDictionary::Find(const std::string& token) const
+{
+  if (!m_dict)
+    return NULL;
+
+  TokenID id = ComputeTokenID(token);
+  for (uint32_t i=LowerBound(id); i<m_token_num && m_dict[i].id == id; i++) {
+    uint32_t begin = m_dict[i].str_offset;
+    uint32_t end = i + 1 < m_token_num ? m_dict[i + 1].str_offset : m_pool_size;
+    if (begin > end || end > m_pool_size)
+      return NULL;
+    if (end - begin == token.size() &&
+        memcmp(m_pool + begin, token.data(), token.size()) == 0)
+      return &m_dict[i];
+  }
+  return NULL;
+}
+
+bool LookaDictionary::GetPostingList(
+  const std::string& token, PostingList& docs) const
+{
+  const IndexDictEntry* e = Find(token);
+  if (!e || e->postings_offset >= m_postings_size)
+    return false;
+  return docs.Map(
+    m_postings + e->postings_offset, m_postings_size - e->postings_offset);
+}
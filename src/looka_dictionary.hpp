@@ -0,0 +1,76 @@
+#ifndef _LOOKA_DICTIONARY_HPP
+#define _LOOKA_DICTIONARY_HPP
+#include <stdint.h>
+#include <string>
+#include "looka_types.hpp"
+#include "looka_mmap.hpp"
+#include "looka_postings.hpp"
+#include "looka_norms.hpp"
+
+// .lci layout: a header, the token dictionary, the token string pool,
+// the postings section and the field length norms (see LookaNorms). The
+// dictionary is sorted by token id and every entry locates one posting
+// list (see PostingList::Write) in the postings section, searchd maps
+// the file and reads it in place.
+const uint32_t kIndexFileMagic   = 0x49434C; // "LCI"
+const uint32_t kIndexFileVersion = 6;
+
+struct IndexFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t token_num;
+  uint32_t pool_size;
+  uint64_t dict_offset;
+  uint64_t pool_offset;
+  uint64_t postings_offset;
+  uint64_t norms_offset;
+  uint64_t file_size;
+};
+
+// Entries are ordered by id, then string. The pool stores the strings in
+// the same order, so the string of an entry ends where the next starts.
+// max_weight is the largest block max_weight of the posting list.
+struct IndexDictEntry {
+  TokenID  id;
+  uint64_t postings_offset;
+  uint32_t doc_freq;
+  uint32_t str_offset;
+  float    max_weight;
+};
+
+// posting lists start on 8 byte boundaries so their skip entries can be
+// read in place
+const uint64_t kPostingsAlign = 8;
+
+// Read-only term dictionary of a mapped index file. Tokens are found by
+// interpolation search on their id, the string is compared to rule out
+// id collisions.
+class LookaDictionary
+{
+public:
+  LookaDictionary();
+  virtual ~LookaDictionary();
+
+  bool Load(const std::string& index_file);
+
+  uint32_t Size() const {return m_token_num;}
+  const IndexDictEntry* Find(const std::string& token) const;
+  // Point docs at the posting list of token, false if it is not indexed.
+  bool GetPostingList(const std::string& token, PostingList& docs) const;
+  const LookaNorms* GetNorms() const {return &m_norms;}
+
+private:
+  uint32_t LowerBound(TokenID id) const;
+
+private:
+  LookaMmap m_mapping;
+  const IndexDictEntry* m_dict;
+  uint32_t    m_token_num;
+  const char* m_pool;
+  uint32_t    m_pool_size;
+  const char* m_postings;
+  uint64_t    m_postings_size;
+  LookaNorms  m_norms;
+};
+
+#endif //_LOOKA_DICTIONARY_HPP
@@ -1,7 +1,11 @@
 #ifndef _LOOKA_FILE_HPP
 #define _LOOKA_FILE_HPP
 
-#include "looka_inverter.hpp"
+#include <map>
+#include "looka_postings.hpp"
+#include "looka_dictionary.hpp"
+#include "looka_norms.hpp"
+#include "looka_attributes.hpp"
 #include "looka_types.hpp"
 
 class LookaIndexReader
@@ -12,20 +16,18 @@ public:
 
   bool ReadIndexFromFile(
     std::string& index_file,
-    LookaInverter<Token, DocInvert*>*& inverte);
+    LookaDictionary*& dictionary);
 
   bool ReadSummaryFromFile(
     std::string& uint_attr_file,
     std::string& float_attr_file,
     std::string& multi_attr_file,
     std::string& string_attr_file,
-    std::map<DocAttrType, AttrNames*>*& attribute_names,
-    std::vector<DocAttr*>*& summary);
+    LookaAttributes*& attributes);
   
   bool ReadSummaryFromFile(
     std::string& summary_file,
-    std::vector<DocAttr*>*& summary,
-    AttrNames*& attr_names,
+    LookaAttributes*& attributes,
     DocAttrType type);
 };
 
@@ -37,12 +39,12 @@ public:
 
   bool WriteIndexToFile(
     std::string& index_file,
-    LookaInverter<Token, DocInvert*>*& inverter);
+    LookaPostings*& postings,
+    LookaNorms*& norms);
 
   bool WriteSummaryToFile(
     std::string& summary_file,
-    std::vector<DocAttr*>*& docs,
-    AttrNames* attr_names,
+    LookaAttributes*& attributes,
     DocAttrType type);
 };
 
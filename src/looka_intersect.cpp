@@ -1,9 +1,12 @@
+#include <algorithm>
 #include "looka_intersect.hpp"
 
 ///////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////
 
-TokenIntersect::TokenIntersect(): docs(NULL), idx(-1)
+TokenIntersect::TokenIntersect():
+  docs(NULL), blocks(NULL), block_num(0), block(0), size(0), idx(0),
+  hit_idx(0), hit_p(NULL), shallow(0)
 {
 }
 
@@ -11,30 +14,148 @@ TokenIntersect::~TokenIntersect()
 {
 }
 
+// First position >= from in ids[0, size) whose doc id is >= id, gallops
+// in doubling steps and binary searches the last step.
+static uint32_t GallopSearch(
+  const LocalDocID* ids, uint32_t from, uint32_t size, LocalDocID id)
+{
+  if (from >= size || ids[from] >= id)
+    return from;
+
+  // keep ids[lo] < id, stop once ids[hi] >= id
+  uint32_t lo = from;
+  uint32_t hi = from + 1;
+  uint32_t step = 1;
+  while (hi < size && ids[hi] < id) {
+    lo = hi;
+    step <<= 1;
+    hi = from + step;
+  }
+  if (hi > size)
+    hi = size;
+
+  lo++;
+  while (lo < hi) {
+    uint32_t mid = lo + ((hi - lo) >> 1);
+    if (ids[mid] < id)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// First block >= from whose max_id is >= id, gallops over the skip
+// entries and binary searches the last step.
+static uint32_t SkipBlocks(
+  const PostingBlock* blocks, uint32_t block_num, uint32_t from, LocalDocID id)
+{
+  uint32_t lo = from;
+  uint32_t hi = from;
+  uint32_t step = 1;
+  while (hi < block_num && blocks[hi].max_id < id) {
+    lo = hi;
+    hi = from + step;
+    step <<= 1;
+  }
+  if (hi > block_num)
+    hi = block_num;
+  while (lo < hi) {
+    uint32_t mid = lo + ((hi - lo) >> 1);
+    if (blocks[mid].max_id < id)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+bool TokenIntersect::SeekBlock(uint32_t from, LocalDocID id)
+{
+  block = SkipBlocks(blocks, block_num, from, id);
+  idx = 0;
+  size = 0;
+  hit_p = NULL;
+  if (block >= block_num)
+    return false;
+  size = docs->DecodeBlock(block, ids);
+  return true;
+}
+
 LocalDocID TokenIntersect::Seek(LocalDocID id)
 {
-  if (!docs)
-    return kIllegalLocalDocID;
-  if (docs->empty())
+  if (!docs || block_num == 0)
     return kIllegalLocalDocID;
-  for (unsigned int i = 0; i < docs->size(); i++) {
-    if ((*docs)[i]->local_id >=  id) {
-      return (*docs)[i]->local_id;
-    }
+
+  if (block >= block_num) {
+    // exhausted, a backwards seek restarts from the first block
+    if (blocks[block_num - 1].max_id < id || !SeekBlock(0, id))
+      return kIllegalLocalDocID;
+  } else if (idx > 0 ? ids[idx - 1] >= id :
+      (block > 0 && blocks[block - 1].max_id >= id)) {
+    // seeking backwards, restart from the first block
+    SeekBlock(0, id);
+  } else if (blocks[block].max_id < id) {
+    if (!SeekBlock(block + 1, id))
+      return kIllegalLocalDocID;
   }
-  return kIllegalLocalDocID;
+
+  idx = GallopSearch(ids, idx, size, id);
+  return ids[idx];
+}
+
+const HitPos* TokenIntersect::GetHits(uint32_t& hits_size)
+{
+  hits_size = 0;
+  if (block >= block_num || idx >= size)
+    return NULL;
+
+  // walk on from the doc read last, docs are visited in id order
+  if (!hit_p || hit_idx > idx) {
+    hit_p = docs->GetBlockHits(block);
+    hit_idx = 0;
+  }
+  for (; hit_idx < idx; hit_idx++) {
+    hit_p += VByteDecode(hit_p, hits_size);
+    hit_p += hits_size;
+  }
+  uint32_t n = VByteDecode(hit_p, hits_size);
+  return hits_size > 0 ? reinterpret_cast<const HitPos*>(hit_p + n) : NULL;
 }
   
-void TokenIntersect::SetDocs(std::vector<DocInvert*>* _docs)
+const PostingBlock* TokenIntersect::ShallowSeek(LocalDocID id)
+{
+  shallow = SkipBlocks(blocks, block_num, shallow, id);
+  return shallow < block_num ? &blocks[shallow] : NULL;
+}
+
+void TokenIntersect::SetDocs(const PostingList* _docs)
 {
   docs = _docs;
-  idx = -1;
+  blocks = docs ? docs->GetBlocks() : NULL;
+  block_num = docs ? docs->GetBlockNum() : 0;
+  block = block_num;
+  size = 0;
+  idx = 0;
+  hit_p = NULL;
+  shallow = 0;
+}
+
+uint32_t TokenIntersect::Size() const
+{
+  return docs ? docs->Size() : 0;
 }
 
 ///////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////
 
-LookaIntersect::LookaIntersect(): tokenInt(NULL), size(0)
+// Above this doc frequency ratio two lists are intersected by seeking
+// the longer one, below it merging every block pair is cheaper.
+static const uint32_t kMergeRatio = 32;
+
+LookaIntersect::LookaIntersect():
+  tokenDocs(NULL), tokenInt(NULL), size(0), merge(false), intersect(GetIntersectFunc()),
+  last_id(0), match_num(0), match_idx(0)
 {
 }
 
@@ -42,14 +163,103 @@ LookaIntersect::~LookaIntersect()
 {
   if (tokenInt)
     delete []tokenInt;
+  if (tokenDocs)
+    delete []tokenDocs;
 }
 
 
+void LookaIntersect::ResetMerge()
+{
+  for (int i=0; i<2; i++) {
+    lists[i].block = 0;
+    lists[i].size = 0;
+  }
+  last_id = 0;
+  match_num = 0;
+  match_idx = 0;
+}
+
+// Move block to the first block that may hold id, a block that is not
+// decoded yet has size 0.
+static void SkipMergeBlocks(
+  const PostingBlock* blocks, uint32_t block_num,
+  uint32_t& block, uint32_t& size, LocalDocID id)
+{
+  if (block < block_num && blocks[block].max_id < id) {
+    block = SkipBlocks(blocks, block_num, block + 1, id);
+    size = 0;
+  }
+}
+
+bool LookaIntersect::FillMatches(LocalDocID id)
+{
+  MergeList& a = lists[0];
+  MergeList& b = lists[1];
+  match_num = 0;
+  match_idx = 0;
+  SkipMergeBlocks(a.blocks, a.block_num, a.block, a.size, id);
+  SkipMergeBlocks(b.blocks, b.block_num, b.block, b.size, id);
+
+  while (a.block < a.block_num && b.block < b.block_num) {
+    LocalDocID a_max = a.blocks[a.block].max_id;
+    LocalDocID b_max = b.blocks[b.block].max_id;
+    // a block only holds ids above the max of the block before it, so a
+    // block ending before the other one starts is skipped undecoded
+    if (b.block > 0 && a_max <= b.blocks[b.block - 1].max_id) {
+      a.block++;
+      a.size = 0;
+      continue;
+    }
+    if (a.block > 0 && b_max <= a.blocks[a.block - 1].max_id) {
+      b.block++;
+      b.size = 0;
+      continue;
+    }
+
+    if (a.size == 0)
+      a.size = a.docs->DecodeBlock(a.block, a.ids);
+    if (b.size == 0)
+      b.size = b.docs->DecodeBlock(b.block, b.ids);
+    match_num = intersect(a.ids, a.size, b.ids, b.size, matches);
+
+    if (a_max <= b_max) {
+      a.block++;
+      a.size = 0;
+    }
+    if (b_max <= a_max) {
+      b.block++;
+      b.size = 0;
+    }
+    if (match_num > 0)
+      return true;
+  }
+  return false;
+}
+
+LocalDocID LookaIntersect::MergeSeek(LocalDocID id)
+{
+  // seeking backwards restarts the merge from the first blocks
+  if (id < last_id)
+    ResetMerge();
+  last_id = id;
+
+  while (true) {
+    while (match_idx < match_num && matches[match_idx] < id)
+      match_idx++;
+    if (match_idx < match_num)
+      return matches[match_idx];
+    if (!FillMatches(id))
+      return kIllegalLocalDocID;
+  }
+}
+
 LocalDocID LookaIntersect::Seek(LocalDocID id)
 {
   LocalDocID next_id;
   if (!tokenInt || size <= 0)
     return kIllegalLocalDocID;
+  if (merge)
+    return MergeSeek(id);
 
   id = tokenInt[0].Seek(id);
   if (id == kIllegalLocalDocID)
@@ -75,26 +285,62 @@ again:
   return id;
 }
 
-std::vector<DocInvert*>* LookaIntersect::GetTokenDocs(
-  std::string token,
-  LookaInverter<Token, DocInvert*>* inverter)
+bool LookaIntersect::GetTokenDocs(
+  const std::string& token,
+  const LookaDictionary* dictionary,
+  PostingList& docs)
 {
-  if (!inverter)
-    return NULL;
-  Token t(token);
-  std::vector<DocInvert*>* docs = NULL;
-  inverter->GetItems(t, docs);
-  return docs;
+  if (!dictionary)
+    return false;
+  return dictionary->GetPostingList(token, docs);
+}
+
+static bool LessDocFreq(const PostingList* a, const PostingList* b)
+{
+  return a->Size() < b->Size();
 }
 
 void LookaIntersect::SetTokens(
   const std::vector<std::string>& tokens,
-  LookaInverter<Token, DocInvert*>* inverter)
+  const LookaDictionary* dictionary)
 {
   if (tokenInt)
-    delete tokenInt;
-  size = tokens.size();
+    delete []tokenInt;
+  if (tokenDocs)
+    delete []tokenDocs;
+  tokenInt = NULL;
+  tokenDocs = NULL;
+  size = 0;
+  merge = false;
+
+  // a token without postings makes the conjunction empty
+  tokenDocs = new PostingList[tokens.size()];
+  std::vector<const PostingList*> token_docs;
+  for (size_t i=0; i<tokens.size(); i++) {
+    PostingList& docs = tokenDocs[i];
+    if (!GetTokenDocs(tokens[i], dictionary, docs) || docs.Size() == 0)
+      return;
+    token_docs.push_back(&docs);
+  }
+
+  size = token_docs.size();
+  if (size <= 0)
+    return;
+
+  // the rarest token drives the walk, the others are only probed
+  std::sort(token_docs.begin(), token_docs.end(), LessDocFreq);
   tokenInt = new TokenIntersect[size];
   for (int i=0; i<size; i++)
-    tokenInt[i].SetDocs(GetTokenDocs(tokens[i], inverter));
+    tokenInt[i].SetDocs(token_docs[i]);
+
+  if (size == 2 &&
+      token_docs[1]->Size() <= (uint64_t)token_docs[0]->Size() * kMergeRatio) {
+    merge = true;
+    for (int i=0; i<2; i++) {
+      lists[i].docs = token_docs[i];
+      lists[i].blocks = token_docs[i]->GetBlocks();
+      lists[i].block_num = token_docs[i]->GetBlockNum();
+    }
+    ResetMerge();
+  }
 }
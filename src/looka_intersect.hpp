@@ -2,19 +2,39 @@
 #define _LOOKA_INTERSECT_HPP
 #include "looka_log.hpp"
 #include "looka_types.hpp"
-#include "looka_inverter.hpp"
+#include "looka_postings.hpp"
+#include "looka_dictionary.hpp"
+#include "looka_intersect_kernel.hpp"
 
 class TokenIntersect {
 public:
   TokenIntersect();
   virtual ~TokenIntersect();
 
-  void SetDocs(std::vector<DocInvert*>* _docs);
+  void SetDocs(const PostingList* _docs);
+  uint32_t Size() const;
   LocalDocID Seek(LocalDocID id);
+  // Hits of the doc the last Seek() landed on.
+  const HitPos* GetHits(uint32_t& hits_size);
+  // Skip entry of the block that would hold id, NULL past the last
+  // block. Reads no postings, ids must not decrease between calls.
+  const PostingBlock* ShallowSeek(LocalDocID id);
 
 private:
-  std::vector<DocInvert*>* docs;
-  unsigned int idx;
+  bool SeekBlock(uint32_t from, LocalDocID id);
+
+private:
+  const PostingList* docs;
+  const PostingBlock* blocks;
+  uint32_t block_num;
+  uint32_t block;
+  uint32_t size;
+  uint32_t idx;
+  LocalDocID ids[kPostingBlockSize];
+  // hits of doc hit_idx of the block start at hit_p, NULL if not read yet
+  uint32_t hit_idx;
+  const uint8_t* hit_p;
+  uint32_t shallow;
 };
 
 class LookaIntersect
@@ -25,17 +45,47 @@ public:
 
   void SetTokens(
     const std::vector<std::string>& tokens,
-    LookaInverter<Token, DocInvert*>* inverter);
+    const LookaDictionary* dictionary);
   
-  std::vector<DocInvert*>* GetTokenDocs(
-    std::string token,
-    LookaInverter<Token, DocInvert*>* inverter);
+  bool GetTokenDocs(
+    const std::string& token,
+    const LookaDictionary* dictionary,
+    PostingList& docs);
 
   LocalDocID Seek(LocalDocID id);
 
+  // Posting lists of the query tokens, in query order.
+  int GetTermNum() const {return size;}
+  const PostingList* GetTermDocs(int i) const {return &tokenDocs[i];}
+
 private:
+  // Two lists of similar size are intersected a block pair at a time
+  // with the simd kernel, the matches are buffered for Seek().
+  struct MergeList {
+    const PostingList*  docs;
+    const PostingBlock* blocks;
+    uint32_t block_num;
+    uint32_t block;
+    uint32_t size;
+    LocalDocID ids[kPostingBlockSize];
+  };
+
+  LocalDocID MergeSeek(LocalDocID id);
+  void ResetMerge();
+  bool FillMatches(LocalDocID id);
+
+private:
+  PostingList* tokenDocs;
   TokenIntersect* tokenInt;
   int size;
+
+  bool merge;
+  MergeList lists[2];
+  IntersectFunc intersect;
+  LocalDocID last_id;
+  uint32_t match_num;
+  uint32_t match_idx;
+  LocalDocID matches[kPostingBlockSize + kIntersectPadding];
 };
 
 #endif //_LOOKA_INTERSECT_HPP
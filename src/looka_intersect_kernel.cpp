@@ -0,0 +1,163 @@
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "looka_intersect_kernel.hpp"
+
+uint32_t IntersectScalar(
+  const LocalDocID* a, uint32_t a_size,
+  const LocalDocID* b, uint32_t b_size,
+  LocalDocID* out)
+{
+  uint32_t i = 0;
+  uint32_t j = 0;
+  uint32_t n = 0;
+  while (i < a_size && j < b_size) {
+    if (a[i] < b[j]) {
+      i++;
+    } else if (a[i] > b[j]) {
+      j++;
+    } else {
+      out[n++] = a[i];
+      i++;
+      j++;
+    }
+  }
+  return n;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Shuffle masks that move the matched lanes of a vector to its front,
+// indexed by the compare mask.
+struct CompactTable {
+  uint8_t  sse[16][16];
+  uint32_t avx2[256][8];
+
+  CompactTable() {
+    for (uint32_t m=0; m<16; m++) {
+      uint32_t n = 0;
+      for (uint32_t k=0; k<4; k++) {
+        if (!(m & (1 << k))) continue;
+        for (uint32_t c=0; c<4; c++)
+          sse[m][n * 4 + c] = k * 4 + c;
+        n++;
+      }
+      for (; n<4; n++)
+        for (uint32_t c=0; c<4; c++)
+          sse[m][n * 4 + c] = 0x80;
+    }
+    for (uint32_t m=0; m<256; m++) {
+      uint32_t n = 0;
+      for (uint32_t k=0; k<8; k++)
+        if (m & (1 << k))
+          avx2[m][n++] = k;
+      for (; n<8; n++)
+        avx2[m][n] = 0;
+    }
+  }
+};
+
+static const CompactTable& GetCompactTable()
+{
+  static CompactTable table;
+  return table;
+}
+
+// Compare 4 ids of a against every rotation of 4 ids of b, then advance
+// whichever side has the smaller last id.
+__attribute__((target("sse4.1")))
+uint32_t IntersectSSE41(
+  const LocalDocID* a, uint32_t a_size,
+  const LocalDocID* b, uint32_t b_size,
+  LocalDocID* out)
+{
+  const CompactTable& table = GetCompactTable();
+  uint32_t i = 0;
+  uint32_t j = 0;
+  uint32_t n = 0;
+  while (i + 4 <= a_size && j + 4 <= b_size) {
+    __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i*)(b + j));
+    __m128i cmp = _mm_cmpeq_epi32(va, vb);
+    vb = _mm_shuffle_epi32(vb, 0x39);
+    cmp = _mm_or_si128(cmp, _mm_cmpeq_epi32(va, vb));
+    vb = _mm_shuffle_epi32(vb, 0x39);
+    cmp = _mm_or_si128(cmp, _mm_cmpeq_epi32(va, vb));
+    vb = _mm_shuffle_epi32(vb, 0x39);
+    cmp = _mm_or_si128(cmp, _mm_cmpeq_epi32(va, vb));
+    if (!_mm_testz_si128(cmp, cmp)) {
+      int mask = _mm_movemask_ps(_mm_castsi128_ps(cmp));
+      __m128i shuf = _mm_loadu_si128((const __m128i*)table.sse[mask]);
+      _mm_storeu_si128((__m128i*)(out + n), _mm_shuffle_epi8(va, shuf));
+      n += __builtin_popcount(mask);
+    }
+    LocalDocID a_max = a[i + 3];
+    LocalDocID b_max = b[j + 3];
+    if (a_max <= b_max)
+      i += 4;
+    if (b_max <= a_max)
+      j += 4;
+  }
+  return n + IntersectScalar(a + i, a_size - i, b + j, b_size - j, out + n);
+}
+
+__attribute__((target("avx2")))
+uint32_t IntersectAVX2(
+  const LocalDocID* a, uint32_t a_size,
+  const LocalDocID* b, uint32_t b_size,
+  LocalDocID* out)
+{
+  const CompactTable& table = GetCompactTable();
+  const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+  uint32_t i = 0;
+  uint32_t j = 0;
+  uint32_t n = 0;
+  while (i + 8 <= a_size && j + 8 <= b_size) {
+    __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+    __m256i vb = _mm256_loadu_si256((const __m256i*)(b + j));
+    __m256i cmp = _mm256_cmpeq_epi32(va, vb);
+    for (uint32_t r=1; r<8; r++) {
+      vb = _mm256_permutevar8x32_epi32(vb, rotate);
+      cmp = _mm256_or_si256(cmp, _mm256_cmpeq_epi32(va, vb));
+    }
+    int mask = _mm256_movemask_ps(_mm256_castsi256_ps(cmp));
+    if (mask) {
+      __m256i perm = _mm256_loadu_si256((const __m256i*)table.avx2[mask]);
+      _mm256_storeu_si256((__m256i*)(out + n),
+        _mm256_permutevar8x32_epi32(va, perm));
+      n += __builtin_popcount(mask);
+    }
+    LocalDocID a_max = a[i + 7];
+    LocalDocID b_max = b[j + 7];
+    if (a_max <= b_max)
+      i += 8;
+    if (b_max <= a_max)
+      j += 8;
+  }
+  return n + IntersectScalar(a + i, a_size - i, b + j, b_size - j, out + n);
+}
+
+static IntersectFunc DetectIntersectFunc()
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return IntersectAVX2;
+  if (__builtin_cpu_supports("sse4.1"))
+    return IntersectSSE41;
+  return IntersectScalar;
+}
+
+IntersectFunc GetIntersectFunc()
+{
+  static IntersectFunc func = DetectIntersectFunc();
+  return func;
+}
+
+#else
+
+IntersectFunc GetIntersectFunc()
+{
+  return IntersectScalar;
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef _LOOKA_INTERSECT_KERNEL_HPP
+#define _LOOKA_INTERSECT_KERNEL_HPP
+#include <stdint.h>
+#include "looka_types.hpp"
+
+// Intersect two sorted doc id arrays into out and return the number of
+// ids written. The SIMD kernels store whole vectors, so out must have
+// room for min(a_size, b_size) + kIntersectPadding ids.
+const uint32_t kIntersectPadding = 8;
+
+typedef uint32_t (*IntersectFunc)(
+  const LocalDocID* a, uint32_t a_size,
+  const LocalDocID* b, uint32_t b_size,
+  LocalDocID* out);
+
+uint32_t IntersectScalar(
+  const LocalDocID* a, uint32_t a_size,
+  const LocalDocID* b, uint32_t b_size,
+  LocalDocID* out);
+
+#if defined(__x86_64__) || defined(__i386__)
+uint32_t IntersectSSE41(
+  const LocalDocID* a, uint32_t a_size,
+  const LocalDocID* b, uint32_t b_size,
+  LocalDocID* out);
+
+uint32_t IntersectAVX2(
+  const LocalDocID* a, uint32_t a_size,
+  const LocalDocID* b, uint32_t b_size,
+  LocalDocID* out);
+#endif
+
+// Best kernel the running cpu supports.
+IntersectFunc GetIntersectFunc();
+
+#endif //_LOOKA_INTERSECT_KERNEL_HPP
@@ -0,0 +1,52 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "looka_mmap.hpp"
+#include "looka_log.hpp"
+
+LookaMmap::LookaMmap(): m_data(NULL), m_size(0)
+{
+}
+
+LookaMmap::~LookaMmap()
+{
+  Close();
+}
+
+bool LookaMmap::Open(const std::string& file)
+{
+  Close();
+
+  int fd = open(file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    _ERROR("[cannot open file %s]", file.c_str());
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    _ERROR("[cannot stat file %s]", file.c_str());
+    close(fd);
+    return false;
+  }
+
+  void* p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    _ERROR("[cannot mmap file %s]", file.c_str());
+    return false;
+  }
+
+  m_data = static_cast<char*>(p);
+  m_size = st.st_size;
+  return true;
+}
+
+void LookaMmap::Close()
+{
+  if (m_data)
+    munmap(m_data, m_size);
+  m_data = NULL;
+  m_size = 0;
+}
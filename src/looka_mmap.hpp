@@ -0,0 +1,29 @@
+#ifndef _LOOKA_MMAP_HPP
+#define _LOOKA_MMAP_HPP
+#include <stdint.h>
+#include <string>
+
+// Read-only mapping of a whole file. Pages are shared with the page
+// cache, so processes mapping the same index share its memory.
+class LookaMmap
+{
+public:
+  LookaMmap();
+  virtual ~LookaMmap();
+
+  bool Open(const std::string& file);
+  void Close();
+
+  const char* Data() const {return m_data;}
+  uint64_t Size() const {return m_size;}
+
+private:
+  LookaMmap(const LookaMmap&);
+  LookaMmap& operator = (const LookaMmap&);
+
+private:
+  char*    m_data;
+  uint64_t m_size;
+};
+
+#endif //_LOOKA_MMAP_HPP
@@ -0,0 +1,69 @@
+#include "looka_norms.hpp"
+
+LookaNorms::LookaNorms():
+  m_field_num(0), m_doc_num(0), m_total_ptr(NULL), m_length_ptr(NULL)
+{
+}
+
+LookaNorms::~LookaNorms()
+{
+}
+
+void LookaNorms::SetFieldNum(uint32_t field_num)
+{
+  m_field_num = field_num;
+  m_doc_num = 0;
+  m_totals.assign(field_num, 0);
+  m_lengths.clear();
+  m_total_ptr = m_totals.empty() ? NULL : &m_totals[0];
+  m_length_ptr = NULL;
+}
+
+void LookaNorms::AddDoc(const std::vector<uint32_t>& lengths)
+{
+  for (uint32_t i=0; i<m_field_num; i++) {
+    uint32_t len = i < lengths.size() ? lengths[i] : 0;
+    if (len > kMaxFieldLength)
+      len = kMaxFieldLength;
+    m_totals[i] += len;
+    m_lengths.push_back(static_cast<uint8_t>(len));
+  }
+  m_doc_num++;
+  m_length_ptr = m_lengths.empty() ? NULL : &m_lengths[0];
+}
+
+bool LookaNorms::Map(const char* data, uint64_t size)
+{
+  const uint64_t header_size = 2 * sizeof(uint32_t);
+  if (size < header_size)
+    return false;
+
+  const uint32_t* header = reinterpret_cast<const uint32_t*>(data);
+  m_field_num = header[0];
+  m_doc_num   = header[1];
+  uint64_t totals_size = (uint64_t)m_field_num * sizeof(uint64_t);
+  if (header_size + totals_size + (uint64_t)m_field_num * m_doc_num > size)
+    return false;
+
+  m_total_ptr  = reinterpret_cast<const uint64_t*>(data + header_size);
+  m_length_ptr = reinterpret_cast<const uint8_t*>(data + header_size + totals_size);
+  return true;
+}
+
+bool LookaNorms::Write(std::ostream& out) const
+{
+  out.write((char*)&m_field_num, sizeof(m_field_num));
+  out.write((char*)&m_doc_num, sizeof(m_doc_num));
+  if (m_field_num > 0)
+    out.write((char*)m_total_ptr, m_field_num * sizeof(uint64_t));
+  if (m_length_ptr)
+    out.write((char*)m_length_ptr, (uint64_t)m_field_num * m_doc_num);
+  return !out.fail();
+}
+
+float LookaNorms::GetAvgLength(FieldID field) const
+{
+  if (field >= m_field_num || m_doc_num == 0)
+    return 0.0f;
+  return static_cast<float>(m_total_ptr[field]) / m_doc_num;
+}
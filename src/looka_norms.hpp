@@ -0,0 +1,48 @@
+#ifndef _LOOKA_NORMS_HPP
+#define _LOOKA_NORMS_HPP
+#include <stdint.h>
+#include <iostream>
+#include <vector>
+#include "looka_types.hpp"
+
+// Longest field length kept, hit positions are 8 bit as well.
+const uint32_t kMaxFieldLength = 255;
+
+// Token count of every indexed field of every doc, the length norm of
+// ranking. The lengths of a doc are stored next to each other, one byte
+// per field, behind the total length of every field across all docs.
+// Like a PostingList the norms are either built with AddDoc() or mapped
+// from an index file with Map().
+class LookaNorms
+{
+public:
+  LookaNorms();
+  virtual ~LookaNorms();
+
+  void SetFieldNum(uint32_t field_num);
+  // Lengths of the fields of the next doc, in field order.
+  void AddDoc(const std::vector<uint32_t>& lengths);
+
+  // Point the norms at their serialized form, data must outlive them.
+  bool Map(const char* data, uint64_t size);
+  bool Write(std::ostream& out) const;
+
+  uint32_t GetFieldNum() const {return m_field_num;}
+  uint32_t GetDocNum() const {return m_doc_num;}
+  uint32_t GetLength(LocalDocID id, FieldID field) const {
+    return m_length_ptr[(uint64_t)id * m_field_num + field];
+  }
+  float GetAvgLength(FieldID field) const;
+
+private:
+  uint32_t m_field_num;
+  uint32_t m_doc_num;
+  const uint64_t* m_total_ptr;
+  const uint8_t*  m_length_ptr;
+
+  // build buffers, empty for mapped norms
+  std::vector<uint64_t> m_totals;
+  std::vector<uint8_t>  m_lengths;
+};
+
+#endif //_LOOKA_NORMS_HPP
@@ -0,0 +1,80 @@
+#include <algorithm>
+#include "looka_output_buffer.hpp"
+
+LookaOutputBuffer::LookaOutputBuffer(size_t chunk_size):
+  m_chunk_size(std::max(chunk_size, (size_t)1)), m_size(0)
+{
+}
+
+void LookaOutputBuffer::NewChunk()
+{
+  m_chunks.push_back(Chunk());
+  m_chunks.back().data.reserve(m_chunk_size);
+}
+
+void LookaOutputBuffer::Append(const char* data, size_t size)
+{
+  m_size += size;
+  while (size > 0) {
+    if (!Writable())
+      NewChunk();
+    std::string& chunk = m_chunks.back().data;
+    size_t n = std::min(size, m_chunk_size - chunk.size());
+    chunk.append(data, n);
+    data += n;
+    size -= n;
+  }
+}
+
+void LookaOutputBuffer::AppendChunk(std::string& chunk)
+{
+  if (chunk.empty())
+    return;
+  m_size += chunk.size();
+  m_chunks.push_back(Chunk());
+  m_chunks.back().data.swap(chunk);
+}
+
+void LookaOutputBuffer::AppendShared(
+  const std::shared_ptr<const std::string>& chunk)
+{
+  if (!chunk || chunk->empty())
+    return;
+  m_size += chunk->size();
+  m_chunks.push_back(Chunk());
+  m_chunks.back().shared = chunk;
+}
+
+void LookaOutputBuffer::AppendBuffer(LookaOutputBuffer& other)
+{
+  for (size_t i = 0; i < other.m_chunks.size(); i++) {
+    Chunk& chunk = other.m_chunks[i];
+    if (chunk.shared)
+      AppendShared(chunk.shared);
+    else
+      AppendChunk(chunk.data);
+  }
+  other.Clear();
+}
+
+void LookaOutputBuffer::Clear()
+{
+  m_chunks.clear();
+  m_size = 0;
+}
+
+void LookaOutputBuffer::Swap(LookaOutputBuffer& other)
+{
+  std::swap(m_chunk_size, other.m_chunk_size);
+  std::swap(m_size, other.m_size);
+  m_chunks.swap(other.m_chunks);
+}
+
+std::string LookaOutputBuffer::ToString() const
+{
+  std::string s;
+  s.reserve(m_size);
+  for (size_t i = 0; i < m_chunks.size(); i++)
+    s.append(GetChunk(i));
+  return s;
+}
@@ -0,0 +1,65 @@
+#ifndef _LOOKA_OUTPUT_BUFFER_HPP
+#define _LOOKA_OUTPUT_BUFFER_HPP
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+
+const size_t kOutputChunkSize = 64 * 1024;
+
+// Output written as a chain of chunks of chunk_size bytes, so that
+// growing it never moves what is already written and it can be sent
+// with one writev without putting it together first. A chunk may also
+// be a string shared with others, it is only read.
+class LookaOutputBuffer
+{
+public:
+  LookaOutputBuffer(size_t chunk_size = kOutputChunkSize);
+  virtual ~LookaOutputBuffer() {}
+
+  void Append(const char* data, size_t size);
+  void Append(const std::string& s) {Append(s.data(), s.size());}
+  void Append(char c) {
+    if (!Writable())
+      NewChunk();
+    m_chunks.back().data.push_back(c);
+    m_size++;
+  }
+  // Takes the bytes of chunk as a chunk of its own, chunk is left empty.
+  void AppendChunk(std::string& chunk);
+  // Refers to chunk, which is shared and not copied.
+  void AppendShared(const std::shared_ptr<const std::string>& chunk);
+  // Moves the chunks of other to the end, other is left empty.
+  void AppendBuffer(LookaOutputBuffer& other);
+
+  void Clear();
+  void Swap(LookaOutputBuffer& other);
+  std::string ToString() const;
+
+  size_t size() const {return m_size;}
+  bool empty() const {return m_size == 0;}
+  size_t GetChunkNum() const {return m_chunks.size();}
+  const std::string& GetChunk(size_t i) const {
+    return m_chunks[i].shared ? *m_chunks[i].shared : m_chunks[i].data;
+  }
+
+private:
+  struct Chunk {
+    std::string data;
+    // set for a shared chunk, data is unused then
+    std::shared_ptr<const std::string> shared;
+  };
+
+  bool Writable() const {
+    return !m_chunks.empty() && !m_chunks.back().shared &&
+      m_chunks.back().data.size() < m_chunk_size;
+  }
+  void NewChunk();
+
+private:
+  size_t m_chunk_size;
+  size_t m_size;
+  std::vector<Chunk> m_chunks;
+};
+
+#endif //_LOOKA_OUTPUT_BUFFER_HPP
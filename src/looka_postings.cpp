@@ -0,0 +1,197 @@
+#include "looka_postings.hpp"
+
+///////////////////////////////////////////////////////
+///////////////////////////////////////////////////////
+
+PostingList::PostingList():
+  doc_num(0), block_num(0), id_bytes(0), hit_bytes(0),
+  block_ptr(NULL), id_ptr(NULL), hit_ptr(NULL)
+{
+}
+
+PostingList::~PostingList()
+{
+}
+
+void PostingList::Add(LocalDocID id, const HitPos* hits, uint32_t hits_size)
+{
+  if (tail.empty()) {
+    PostingBlock block = {id, (uint32_t)id_data.size(), (uint32_t)hit_data.size(), 0.0f};
+    blocks.push_back(block);
+  }
+
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(hits);
+  VByteEncode(hits_size, hit_data);
+  hit_data.insert(hit_data.end(), p, p + hits_size);
+
+  tail.push_back(id);
+  doc_num++;
+  if (tail.size() == kPostingBlockSize)
+    EncodeTail();
+}
+
+void PostingList::Finish()
+{
+  EncodeTail();
+  block_num = blocks.size();
+  id_bytes  = id_data.size();
+  hit_bytes = hit_data.size();
+  block_ptr = blocks.empty() ? NULL : &blocks[0];
+  id_ptr    = id_data.empty() ? NULL : &id_data[0];
+  hit_ptr   = hit_data.empty() ? NULL : &hit_data[0];
+}
+
+void PostingList::EncodeTail()
+{
+  if (tail.empty())
+    return;
+
+  PostingBlock& block = blocks.back();
+  LocalDocID base = blocks.size() > 1 ? blocks[blocks.size() - 2].max_id : 0;
+  for (size_t i=0; i<tail.size(); i++) {
+    LocalDocID id = tail[i];
+    tail[i] = id - base;
+    base = id;
+  }
+
+  if (tail.size() == kPostingBlockSize) {
+    PackBlock(&tail[0], id_data);
+  } else {
+    for (size_t i=0; i<tail.size(); i++)
+      VByteEncode(tail[i], id_data);
+  }
+  block.max_id = base;
+  tail.clear();
+}
+
+bool PostingList::Map(const char* data, uint64_t size)
+{
+  const uint64_t header_size = 4 * sizeof(uint32_t);
+  if (size < header_size)
+    return false;
+
+  const uint32_t* header = reinterpret_cast<const uint32_t*>(data);
+  doc_num   = header[0];
+  block_num = header[1];
+  id_bytes  = header[2];
+  hit_bytes = header[3];
+  if (block_num != (doc_num + kPostingBlockSize - 1) / kPostingBlockSize)
+    return false;
+  uint64_t blocks_size = (uint64_t)block_num * sizeof(PostingBlock);
+  if (header_size + blocks_size + id_bytes + hit_bytes > size)
+    return false;
+
+  const char* p = data + header_size;
+  block_ptr = reinterpret_cast<const PostingBlock*>(p);
+  id_ptr    = reinterpret_cast<const uint8_t*>(p + blocks_size);
+  hit_ptr   = id_ptr + id_bytes;
+  return true;
+}
+
+bool PostingList::Write(std::ostream& out) const
+{
+  out.write((char*)&doc_num, sizeof(doc_num));
+  out.write((char*)&block_num, sizeof(block_num));
+  out.write((char*)&id_bytes, sizeof(id_bytes));
+  out.write((char*)&hit_bytes, sizeof(hit_bytes));
+  if (block_num > 0)
+    out.write((char*)block_ptr, block_num * sizeof(PostingBlock));
+  if (id_bytes > 0)
+    out.write((char*)id_ptr, id_bytes);
+  if (hit_bytes > 0)
+    out.write((char*)hit_ptr, hit_bytes);
+  return !out.fail();
+}
+
+uint32_t PostingList::GetBlockSize(uint32_t b) const
+{
+  if (b + 1 < block_num)
+    return kPostingBlockSize;
+  if (b + 1 == block_num)
+    return doc_num - b * kPostingBlockSize;
+  return 0;
+}
+
+uint32_t PostingList::DecodeBlock(uint32_t b, LocalDocID* out) const
+{
+  uint32_t size = GetBlockSize(b);
+  if (size == 0)
+    return 0;
+
+  const uint8_t* p = id_ptr + block_ptr[b].id_offset;
+  if (size == kPostingBlockSize) {
+    UnpackBlock(p, out);
+  } else {
+    for (uint32_t i=0; i<size; i++)
+      p += VByteDecode(p, out[i]);
+  }
+  PrefixSum(out, size, b > 0 ? block_ptr[b - 1].max_id : 0);
+  return size;
+}
+
+const HitPos* PostingList::GetHitsData(uint32_t i, uint32_t& hits_size) const
+{
+  hits_size = 0;
+  if (i >= doc_num)
+    return NULL;
+
+  // walk the hits of the docs before i in its block
+  const uint8_t* p = GetBlockHits(i / kPostingBlockSize);
+  for (uint32_t k = i % kPostingBlockSize; k > 0; k--) {
+    p += VByteDecode(p, hits_size);
+    p += hits_size;
+  }
+  p += VByteDecode(p, hits_size);
+  return hits_size > 0 ? reinterpret_cast<const HitPos*>(p) : NULL;
+}
+
+void PostingList::GetHits(uint32_t i, std::vector<const HitPos*>& h) const
+{
+  uint32_t hits_size = 0;
+  const char* hits = reinterpret_cast<const char*>(GetHitsData(i, hits_size));
+  uint32_t cur_size = 0;
+  while (hits && cur_size < hits_size) {
+    const HitPos* hit = reinterpret_cast<const HitPos*>(hits + cur_size);
+    cur_size += sizeof(HitPos) + hit->count * sizeof(uint8_t);
+    h.push_back(hit);
+  }
+}
+
+///////////////////////////////////////////////////////
+///////////////////////////////////////////////////////
+
+LookaPostings::LookaPostings()
+{
+}
+
+LookaPostings::~LookaPostings()
+{
+}
+
+PostingList* LookaPostings::GetOrCreate(const Token& key)
+{
+  return &m_postings[key];
+}
+
+const PostingList* LookaPostings::GetPostingList(const Token& key) const
+{
+  PostingsConstIter_t it = m_postings.find(key);
+  if (it == m_postings.end())
+    return NULL;
+  return &(it->second);
+}
+
+uint32_t LookaPostings::GetKeys(std::vector<Token>& keys) const
+{
+  PostingsConstIter_t it = m_postings.begin();
+  for (; it != m_postings.end(); ++it)
+    keys.push_back(it->first);
+  return keys.size();
+}
+
+void LookaPostings::Finish()
+{
+  PostingsIter_t it = m_postings.begin();
+  for (; it != m_postings.end(); ++it)
+    it->second.Finish();
+}
@@ -0,0 +1,94 @@
+#ifndef _LOOKA_POSTINGS_HPP
+#define _LOOKA_POSTINGS_HPP
+#include <stdint.h>
+#include <iostream>
+#include <vector>
+#include <unordered_map>
+#include "looka_types.hpp"
+#include "looka_codec.hpp"
+
+// Skip entry of one block of a posting list. max_weight bounds the
+// ranking weight of the token in the docs of the block (see LookaRanker).
+struct PostingBlock {
+  LocalDocID max_id;
+  uint32_t   id_offset;
+  uint32_t   hit_offset;
+  float      max_weight;
+};
+
+// Posting list of one token. Doc ids are delta encoded in blocks of
+// kPostingBlockSize, each block has a skip entry with its largest doc id
+// so seeking only decodes the blocks it lands in. The HitPos records of
+// every doc live in a separate arena and are only read for docs that
+// match. A list is either built with Add() or mapped from an index file
+// with Map(), the accessors read the same layout in both cases.
+class PostingList
+{
+public:
+  PostingList();
+  virtual ~PostingList();
+
+  // Docs must be added in increasing id order, Finish() encodes the
+  // last partial block and must be called once after the last Add().
+  void Add(LocalDocID id, const HitPos* hits, uint32_t hits_size);
+  void Finish();
+
+  // Point the list at its serialized form, data must outlive the list.
+  bool Map(const char* data, uint64_t size);
+  bool Write(std::ostream& out) const;
+
+  uint32_t Size() const {return doc_num;}
+  uint32_t GetBlockNum() const {return block_num;}
+  const PostingBlock* GetBlocks() const {return block_num ? block_ptr : NULL;}
+  uint32_t GetBlockSize(uint32_t b) const;
+  // Decode the doc ids of block b into out, returns the number of ids.
+  uint32_t DecodeBlock(uint32_t b, LocalDocID* out) const;
+  // Only for built lists, after Finish().
+  void SetBlockMaxWeight(uint32_t b, float w) {blocks[b].max_weight = w;}
+
+  // Hits arena of block b, every doc of the block in turn is stored as
+  // VByte(hits_size) followed by hits_size bytes of HitPos records.
+  const uint8_t* GetBlockHits(uint32_t b) const {return hit_ptr + block_ptr[b].hit_offset;}
+  // Hits of the i-th doc of the list.
+  const HitPos* GetHitsData(uint32_t i, uint32_t& hits_size) const;
+  void GetHits(uint32_t i, std::vector<const HitPos*>& h) const;
+
+private:
+  void EncodeTail();
+
+private:
+  uint32_t doc_num;
+  uint32_t block_num;
+  uint32_t id_bytes;
+  uint32_t hit_bytes;
+  const PostingBlock* block_ptr;
+  const uint8_t*      id_ptr;
+  const uint8_t*      hit_ptr;
+
+  // build buffers, empty for mapped lists
+  std::vector<PostingBlock> blocks;
+  std::vector<uint8_t>      id_data;
+  std::vector<uint8_t>      hit_data;
+  std::vector<LocalDocID>   tail;
+};
+
+class LookaPostings
+{
+public:
+  LookaPostings();
+  virtual ~LookaPostings();
+
+  PostingList* GetOrCreate(const Token& key);
+  const PostingList* GetPostingList(const Token& key) const;
+  uint32_t GetKeys(std::vector<Token>& keys) const;
+  void Finish();
+
+private:
+  typedef std::unordered_map<Token, PostingList, Token::Hash> Postings_t;
+  typedef Postings_t::iterator PostingsIter_t;
+  typedef Postings_t::const_iterator PostingsConstIter_t;
+
+  Postings_t m_postings;
+};
+
+#endif //_LOOKA_POSTINGS_HPP
@@ -0,0 +1,271 @@
+#include <ctype.h>
+#include <strings.h>
+#include "looka_query.hpp"
+#include "looka_string_utils.hpp"
+
+QueryNode::~QueryNode()
+{
+  for (size_t i=0; i<children.size(); i++)
+    delete children[i];
+}
+
+static bool IsQuerySpace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool IsQueryOperator(char c)
+{
+  return c == '|' || c == '(' || c == ')' || c == '"';
+}
+
+// Pulls nested nodes of the same kind up and drops and/or nodes with
+// fewer than two children, NULL if nothing is left.
+static QueryNode* Simplify(QueryNode* node)
+{
+  if (node->type != QUERY_AND && node->type != QUERY_OR &&
+      node->type != QUERY_PHRASE)
+    return node;
+
+  std::vector<QueryNode*> children;
+  for (size_t i=0; i<node->children.size(); i++) {
+    QueryNode* child = node->children[i];
+    if (child->type == node->type && node->type != QUERY_PHRASE) {
+      children.insert(children.end(), child->children.begin(), child->children.end());
+      child->children.clear();
+      delete child;
+    } else {
+      children.push_back(child);
+    }
+  }
+  node->children.swap(children);
+
+  if (node->children.size() == 1 && node->children[0]->type != QUERY_NOT) {
+    QueryNode* child = node->children[0];
+    node->children.clear();
+    delete node;
+    return child;
+  }
+  if (node->children.empty()) {
+    delete node;
+    return NULL;
+  }
+  return node;
+}
+
+LookaQueryParser::LookaQueryParser(
+  LookaSegmenter* segmenter,
+  const std::vector<std::string>& fields,
+  bool match_any):
+  m_segmenter(segmenter), m_field_names(fields), m_match_any(match_any),
+  m_fields(kAllQueryFields), m_pos(0), m_depth(0)
+{
+}
+
+LookaQueryParser::~LookaQueryParser()
+{
+}
+
+QueryNode* LookaQueryParser::Parse(const std::string& query)
+{
+  m_query = query;
+  m_pos = 0;
+  m_depth = 0;
+  m_fields = kAllQueryFields;
+  if (!m_segmenter)
+    return NULL;
+  return ParseOr();
+}
+
+void LookaQueryParser::SkipSpaces()
+{
+  while (m_pos < m_query.size() && IsQuerySpace(m_query[m_pos]))
+    m_pos++;
+}
+
+bool LookaQueryParser::AtSequenceEnd()
+{
+  SkipSpaces();
+  if (m_pos >= m_query.size())
+    return true;
+  char c = m_query[m_pos];
+  return c == '|' || (c == ')' && m_depth > 0);
+}
+
+QueryNode* LookaQueryParser::ParseOr()
+{
+  QueryNode* node = new QueryNode(QUERY_OR);
+  // a field limit ends with the group
+  uint64_t fields = m_fields;
+  while (true) {
+    QueryNode* child = ParseSequence();
+    if (child)
+      node->children.push_back(child);
+    if (m_pos < m_query.size() && m_query[m_pos] == '|') {
+      m_pos++;
+      continue;
+    }
+    break;
+  }
+  m_fields = fields;
+  return Simplify(node);
+}
+
+QueryNode* LookaQueryParser::ParseSequence()
+{
+  QueryNode* node = new QueryNode(m_match_any ? QUERY_OR : QUERY_AND);
+  std::vector<QueryNode*> excludes;
+  while (!AtSequenceEnd()) {
+    QueryNode* child = ParseUnary();
+    if (!child)
+      continue;
+    if (child->type == QUERY_NOT)
+      excludes.push_back(child);
+    else
+      node->children.push_back(child);
+  }
+
+  // excluding docs needs docs to exclude them from
+  node = Simplify(node);
+  if (!node || excludes.empty()) {
+    for (size_t i=0; i<excludes.size(); i++)
+      delete excludes[i];
+    return node;
+  }
+  if (node->type != QUERY_AND) {
+    QueryNode* and_node = new QueryNode(QUERY_AND);
+    and_node->children.push_back(node);
+    node = and_node;
+  }
+  node->children.insert(node->children.end(), excludes.begin(), excludes.end());
+  return node;
+}
+
+QueryNode* LookaQueryParser::ParseUnary()
+{
+  SkipSpaces();
+  char c = m_query[m_pos];
+  if (c == '-' || c == '!') {
+    m_pos++;
+    QueryNode* child = ParseUnary();
+    if (!child)
+      return NULL;
+    if (child->type == QUERY_NOT) {
+      QueryNode* inner = child->children[0];
+      child->children.clear();
+      delete child;
+      return inner;
+    }
+    QueryNode* node = new QueryNode(QUERY_NOT);
+    node->children.push_back(child);
+    return node;
+  }
+
+  if (c == '@') {
+    // the limit holds from here on, so -@title a negates a in the title
+    m_pos++;
+    ParseFields();
+    return AtSequenceEnd() ? NULL : ParseUnary();
+  }
+
+  if (c == '(') {
+    m_pos++;
+    m_depth++;
+    QueryNode* node = ParseOr();
+    m_depth--;
+    if (m_pos < m_query.size() && m_query[m_pos] == ')')
+      m_pos++;
+    return node;
+  }
+
+  if (c == ')') {
+    // closes the group, or is unbalanced and ignored
+    if (m_depth == 0)
+      m_pos++;
+    return NULL;
+  }
+
+  if (c == '"') {
+    size_t end = m_query.find('"', ++m_pos);
+    if (end == std::string::npos)
+      end = m_query.size();
+    std::string phrase = m_query.substr(m_pos, end - m_pos);
+    m_pos = end < m_query.size() ? end + 1 : end;
+    return ParseWord(phrase, true);
+  }
+
+  size_t start = m_pos;
+  while (m_pos < m_query.size() &&
+      !IsQuerySpace(m_query[m_pos]) && !IsQueryOperator(m_query[m_pos]))
+    m_pos++;
+  return ParseWord(m_query.substr(start, m_pos - start), false);
+}
+
+QueryNode* LookaQueryParser::ParseWord(const std::string& word, bool phrase)
+{
+  std::vector<SegmentToken> tokens;
+  std::string s = word;
+  m_segmenter->Segment(s, tokens);
+
+  QueryNode* node = new QueryNode(
+    phrase ? QUERY_PHRASE : (m_match_any ? QUERY_OR : QUERY_AND));
+  for (size_t i=0; i<tokens.size(); i++) {
+    const std::string& str = tokens[i].str;
+    if (str.find_first_not_of(" \t\r\n") == std::string::npos)
+      continue;
+    QueryNode* term = new QueryNode(QUERY_TERM);
+    term->token = str;
+    term->pos = tokens[i].pos;
+    term->fields = m_fields;
+    node->children.push_back(term);
+  }
+  node->fields = m_fields;
+  return Simplify(node);
+}
+
+static bool IsFieldNameChar(char c)
+{
+  return isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+void LookaQueryParser::ParseFields()
+{
+  if (m_pos < m_query.size() && m_query[m_pos] == '*') {
+    m_pos++;
+    m_fields = kAllQueryFields;
+    return;
+  }
+
+  std::vector<std::string> names;
+  if (m_pos < m_query.size() && m_query[m_pos] == '(') {
+    size_t end = m_query.find(')', ++m_pos);
+    if (end == std::string::npos)
+      end = m_query.size();
+    splitString(m_query.substr(m_pos, end - m_pos), ',', names);
+    m_pos = end < m_query.size() ? end + 1 : end;
+  } else {
+    size_t start = m_pos;
+    while (m_pos < m_query.size() && IsFieldNameChar(m_query[m_pos]))
+      m_pos++;
+    names.push_back(m_query.substr(start, m_pos - start));
+  }
+
+  // unknown fields hold nothing, the words limited to them match nothing
+  m_fields = 0;
+  for (size_t i=0; i<names.size(); i++)
+    for (size_t f=0; f<m_field_names.size() && f<64; f++)
+      if (strcasecmp(trim(names[i]).c_str(), m_field_names[f].c_str()) == 0)
+        m_fields |= 1ULL << f;
+}
+
+void GetQueryTerms(const QueryNode* node, std::vector<const QueryNode*>& terms)
+{
+  if (!node || node->type == QUERY_NOT)
+    return;
+  if (node->type == QUERY_TERM) {
+    terms.push_back(node);
+    return;
+  }
+  for (size_t i=0; i<node->children.size(); i++)
+    GetQueryTerms(node->children[i], terms);
+}
@@ -0,0 +1,82 @@
+#ifndef _LOOKA_QUERY_HPP
+#define _LOOKA_QUERY_HPP
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "looka_segmenter.hpp"
+
+// Field mask of a term, bit i stands for the i-th sql_field_string.
+const uint64_t kAllQueryFields = ~0ULL;
+
+enum QueryNodeType {
+  QUERY_TERM = 0,
+  QUERY_AND,
+  QUERY_OR,
+  QUERY_NOT,
+  QUERY_PHRASE,
+};
+
+// Node of a parsed query. A term holds its token, the fields it is
+// searched in and, inside a phrase, the position the segmenter gave it
+// in the query. The children of a phrase are its terms, a not has
+// exactly one child and only appears among the children of an and.
+struct QueryNode {
+  QueryNodeType type;
+  std::string token;
+  uint32_t pos;
+  uint64_t fields;
+  std::vector<QueryNode*> children;
+
+  QueryNode(QueryNodeType t): type(t), pos(0), fields(kAllQueryFields) {}
+  virtual ~QueryNode();
+};
+
+// Parses the query syntax:
+//
+//   a b        docs with a and b (with a or b if match_any)
+//   a | b      docs with a or b
+//   -a, !a     docs without a
+//   "a b"      a directly followed by b
+//   ( )        grouping
+//   @title a   a in the title field only, up to the next @ or the end of
+//              the group, @(title,author) for several fields, @* for all
+//
+// The words between the operators are segmented, the tokens of a word
+// are joined like the words are.
+class LookaQueryParser
+{
+public:
+  // fields are the names of the indexed fields in FieldID order.
+  LookaQueryParser(
+    LookaSegmenter* segmenter,
+    const std::vector<std::string>& fields,
+    bool match_any);
+  virtual ~LookaQueryParser();
+
+  // NULL if the query matches nothing.
+  QueryNode* Parse(const std::string& query);
+
+private:
+  QueryNode* ParseOr();
+  QueryNode* ParseSequence();
+  QueryNode* ParseUnary();
+  QueryNode* ParseWord(const std::string& word, bool phrase);
+  void ParseFields();
+
+  bool AtSequenceEnd();
+  void SkipSpaces();
+
+private:
+  LookaSegmenter* m_segmenter;
+  const std::vector<std::string>& m_field_names;
+  bool m_match_any;
+  uint64_t m_fields;
+  std::string m_query;
+  size_t m_pos;
+  int m_depth;
+};
+
+// Terms of a query that are not negated, in query order.
+void GetQueryTerms(const QueryNode* node, std::vector<const QueryNode*>& terms);
+
+#endif //_LOOKA_QUERY_HPP
@@ -0,0 +1,349 @@
+#include <string.h>
+#include <algorithm>
+#include "looka_query_executor.hpp"
+
+///////////////////////////////////////////////////////
+///////////////////////////////////////////////////////
+
+// Whether a field is one of the fields of a mask.
+static bool InFields(uint64_t fields, FieldID field)
+{
+  return fields == kAllQueryFields || (field < 64 && (fields >> field) & 1);
+}
+
+TermIterator::TermIterator(
+  const std::string& token, uint64_t fields, const LookaDictionary* dictionary):
+  m_fields(fields)
+{
+  if (fields != 0 && dictionary && dictionary->GetPostingList(token, m_list))
+    m_docs.SetDocs(&m_list);
+}
+
+TermIterator::~TermIterator()
+{
+}
+
+LocalDocID TermIterator::Seek(LocalDocID id)
+{
+  while ((id = m_docs.Seek(id)) != kIllegalLocalDocID) {
+    if (m_fields == kAllQueryFields)
+      return id;
+
+    uint32_t hits_size;
+    const char* p = reinterpret_cast<const char*>(m_docs.GetHits(hits_size));
+    const char* end = p + hits_size;
+    for (; p && p < end; p += sizeof(HitPos) + reinterpret_cast<const HitPos*>(p)->count)
+      if (InFields(m_fields, reinterpret_cast<const HitPos*>(p)->field))
+        return id;
+    id++;
+  }
+  return id;
+}
+
+uint32_t TermIterator::Cost() const
+{
+  return m_docs.Size();
+}
+
+///////////////////////////////////////////////////////
+///////////////////////////////////////////////////////
+
+IntersectIterator::IntersectIterator(
+  const std::vector<std::string>& tokens, const LookaDictionary* dictionary)
+{
+  m_intersect.SetTokens(tokens, dictionary);
+}
+
+IntersectIterator::~IntersectIterator()
+{
+}
+
+LocalDocID IntersectIterator::Seek(LocalDocID id)
+{
+  return m_intersect.Seek(id);
+}
+
+uint32_t IntersectIterator::Cost() const
+{
+  uint32_t cost = 0;
+  for (int i=0; i<m_intersect.GetTermNum(); i++)
+    if (i == 0 || m_intersect.GetTermDocs(i)->Size() < cost)
+      cost = m_intersect.GetTermDocs(i)->Size();
+  return cost;
+}
+
+///////////////////////////////////////////////////////
+///////////////////////////////////////////////////////
+
+static bool LessCost(const QueryIterator* a, const QueryIterator* b)
+{
+  return a->Cost() < b->Cost();
+}
+
+AndIterator::AndIterator(
+  const std::vector<QueryIterator*>& children,
+  const std::vector<QueryIterator*>& excludes):
+  m_children(children), m_excludes(excludes)
+{
+  std::sort(m_children.begin(), m_children.end(), LessCost);
+}
+
+AndIterator::~AndIterator()
+{
+  for (size_t i=0; i<m_children.size(); i++)
+    delete m_children[i];
+  for (size_t i=0; i<m_excludes.size(); i++)
+    delete m_excludes[i];
+}
+
+LocalDocID AndIterator::Seek(LocalDocID id)
+{
+  size_t n = m_children.size();
+  if (n == 0)
+    return kIllegalLocalDocID;
+
+  while (true) {
+    // leapfrog until every child agrees on a doc
+    id = m_children[0]->Seek(id);
+    size_t agreed = 1;
+    for (size_t i=1; agreed<n && id!=kIllegalLocalDocID; i=(i+1)%n) {
+      LocalDocID next = m_children[i]->Seek(id);
+      if (next == id) {
+        agreed++;
+      } else {
+        id = next;
+        agreed = 1;
+      }
+    }
+    if (id == kIllegalLocalDocID)
+      return id;
+
+    bool excluded = false;
+    for (size_t i=0; i<m_excludes.size() && !excluded; i++)
+      excluded = m_excludes[i]->Seek(id) == id;
+    if (!excluded)
+      return id;
+    id++;
+  }
+}
+
+uint32_t AndIterator::Cost() const
+{
+  return m_children.empty() ? 0 : m_children[0]->Cost();
+}
+
+///////////////////////////////////////////////////////
+///////////////////////////////////////////////////////
+
+// a is after b, the heap top is the child at the smallest doc
+static bool LaterEntry(const OrIterator::Entry& a, const OrIterator::Entry& b)
+{
+  return a.id > b.id;
+}
+
+OrIterator::OrIterator(const std::vector<QueryIterator*>& children):
+  m_children(children), m_last_id(0)
+{
+}
+
+OrIterator::~OrIterator()
+{
+  for (size_t i=0; i<m_children.size(); i++)
+    delete m_children[i];
+}
+
+LocalDocID OrIterator::Seek(LocalDocID id)
+{
+  // seeking backwards restarts every child
+  if (m_heap.empty() || id < m_last_id) {
+    m_heap.clear();
+    for (size_t i=0; i<m_children.size(); i++) {
+      Entry e = {m_children[i]->Seek(id), m_children[i]};
+      m_heap.push_back(e);
+    }
+    std::make_heap(m_heap.begin(), m_heap.end(), LaterEntry);
+  }
+  m_last_id = id;
+
+  while (!m_heap.empty() && m_heap.front().id < id) {
+    std::pop_heap(m_heap.begin(), m_heap.end(), LaterEntry);
+    Entry& e = m_heap.back();
+    e.id = e.it->Seek(id);
+    std::push_heap(m_heap.begin(), m_heap.end(), LaterEntry);
+  }
+  return m_heap.empty() ? kIllegalLocalDocID : m_heap.front().id;
+}
+
+uint32_t OrIterator::Cost() const
+{
+  uint64_t cost = 0;
+  for (size_t i=0; i<m_children.size(); i++)
+    cost += m_children[i]->Cost();
+  return cost < kuint32max ? cost : kuint32max;
+}
+
+///////////////////////////////////////////////////////
+///////////////////////////////////////////////////////
+
+PhraseIterator::PhraseIterator(
+  const QueryNode* node, const LookaDictionary* dictionary):
+  m_fields(node->fields)
+{
+  std::vector<std::string> tokens;
+  for (size_t i=0; i<node->children.size(); i++) {
+    tokens.push_back(node->children[i]->token);
+    m_deltas.push_back(
+      static_cast<uint8_t>(node->children[i]->pos - node->children[0]->pos));
+  }
+  m_intersect.SetTokens(tokens, dictionary);
+
+  m_terms.resize(m_intersect.GetTermNum());
+  for (size_t i=0; i<m_terms.size(); i++)
+    m_terms[i].SetDocs(m_intersect.GetTermDocs(i));
+  m_positions.resize(m_terms.size() * 4);
+}
+
+PhraseIterator::~PhraseIterator()
+{
+}
+
+// Hits of a doc in one field, NULL if the token is not in it.
+static const HitPos* FindFieldHits(
+  const HitPos* hits, uint32_t hits_size, FieldID field)
+{
+  const char* p = reinterpret_cast<const char*>(hits);
+  const char* end = p + hits_size;
+  while (p < end) {
+    const HitPos* hit = reinterpret_cast<const HitPos*>(p);
+    if (hit->field == field)
+      return hit;
+    p += sizeof(HitPos) + hit->count * sizeof(uint8_t);
+  }
+  return NULL;
+}
+
+bool PhraseIterator::Match(LocalDocID id)
+{
+  size_t n = m_terms.size();
+  std::vector<const HitPos*> hits(n);
+  std::vector<uint32_t> sizes(n);
+  for (size_t i=0; i<n; i++) {
+    if (m_terms[i].Seek(id) != id)
+      return false;
+    hits[i] = m_terms[i].GetHits(sizes[i]);
+    if (!hits[i])
+      return false;
+  }
+
+  // every field of the first term, then every position of it in there
+  const char* p = reinterpret_cast<const char*>(hits[0]);
+  const char* end = p + sizes[0];
+  for (; p < end; p += sizeof(HitPos) + reinterpret_cast<const HitPos*>(p)->count) {
+    const HitPos* first = reinterpret_cast<const HitPos*>(p);
+    if (!InFields(m_fields, first->field))
+      continue;
+    bool in_field = true;
+    memset(&m_positions[0], 0, m_positions.size() * sizeof(uint64_t));
+    for (size_t i=1; i<n && in_field; i++) {
+      const HitPos* hit = FindFieldHits(hits[i], sizes[i], first->field);
+      in_field = hit != NULL;
+      for (uint32_t j=0; hit && j<hit->count; j++)
+        m_positions[i * 4 + (hit->pos[j] >> 6)] |= 1ULL << (hit->pos[j] & 63);
+    }
+    if (!in_field)
+      continue;
+
+    for (uint32_t j=0; j<first->count; j++) {
+      size_t i = 1;
+      for (; i<n; i++) {
+        // positions stop at 255, a later one can not be in the field
+        uint32_t pos = first->pos[j] + m_deltas[i];
+        if (pos > 255 || !(m_positions[i * 4 + (pos >> 6)] & (1ULL << (pos & 63))))
+          break;
+      }
+      if (i == n)
+        return true;
+    }
+  }
+  return false;
+}
+
+LocalDocID PhraseIterator::Seek(LocalDocID id)
+{
+  while ((id = m_intersect.Seek(id)) != kIllegalLocalDocID) {
+    if (Match(id))
+      return id;
+    id++;
+  }
+  return id;
+}
+
+uint32_t PhraseIterator::Cost() const
+{
+  uint32_t cost = 0;
+  for (size_t i=0; i<m_terms.size(); i++)
+    if (i == 0 || m_terms[i].Size() < cost)
+      cost = m_terms[i].Size();
+  return cost;
+}
+
+///////////////////////////////////////////////////////
+///////////////////////////////////////////////////////
+
+LookaQueryExecutor::LookaQueryExecutor(): m_root(NULL)
+{
+}
+
+LookaQueryExecutor::~LookaQueryExecutor()
+{
+  if (m_root)
+    delete m_root;
+}
+
+void LookaQueryExecutor::Build(
+  const QueryNode* root, const LookaDictionary* dictionary)
+{
+  if (m_root)
+    delete m_root;
+  m_root = root ? Create(root, dictionary) : NULL;
+}
+
+QueryIterator* LookaQueryExecutor::Create(
+  const QueryNode* node, const LookaDictionary* dictionary)
+{
+  if (node->type == QUERY_TERM)
+    return new TermIterator(node->token, node->fields, dictionary);
+  if (node->type == QUERY_PHRASE)
+    return new PhraseIterator(node, dictionary);
+
+  std::vector<QueryIterator*> children;
+  if (node->type == QUERY_OR) {
+    for (size_t i=0; i<node->children.size(); i++)
+      children.push_back(Create(node->children[i], dictionary));
+    return new OrIterator(children);
+  }
+
+  // and: the terms of every field go to one intersection, the rest
+  // leapfrog it
+  std::vector<std::string> tokens;
+  std::vector<QueryIterator*> excludes;
+  for (size_t i=0; i<node->children.size(); i++) {
+    const QueryNode* child = node->children[i];
+    if (child->type == QUERY_TERM && child->fields == kAllQueryFields)
+      tokens.push_back(child->token);
+    else if (child->type == QUERY_NOT)
+      excludes.push_back(Create(child->children[0], dictionary));
+    else
+      children.push_back(Create(child, dictionary));
+  }
+  if (tokens.size() == 1)
+    children.push_back(new TermIterator(tokens[0], kAllQueryFields, dictionary));
+  else if (tokens.size() > 1)
+    children.push_back(new IntersectIterator(tokens, dictionary));
+  return new AndIterator(children, excludes);
+}
+
+LocalDocID LookaQueryExecutor::Seek(LocalDocID id)
+{
+  return m_root ? m_root->Seek(id) : kIllegalLocalDocID;
+}
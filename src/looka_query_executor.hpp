@@ -0,0 +1,137 @@
+#ifndef _LOOKA_QUERY_EXECUTOR_HPP
+#define _LOOKA_QUERY_EXECUTOR_HPP
+#include <vector>
+#include "looka_types.hpp"
+#include "looka_postings.hpp"
+#include "looka_dictionary.hpp"
+#include "looka_intersect.hpp"
+#include "looka_query.hpp"
+
+// Iterator over the docs matching one node of a query tree.
+class QueryIterator
+{
+public:
+  QueryIterator() {}
+  virtual ~QueryIterator() {}
+
+  // First matching doc >= id, kIllegalLocalDocID past the last one.
+  virtual LocalDocID Seek(LocalDocID id) = 0;
+  // Upper bound of the matching docs, the cheapest child of an and
+  // drives it.
+  virtual uint32_t Cost() const = 0;
+};
+
+// Docs holding a token in one of the given fields.
+class TermIterator: public QueryIterator
+{
+public:
+  TermIterator(
+    const std::string& token, uint64_t fields, const LookaDictionary* dictionary);
+  virtual ~TermIterator();
+
+  virtual LocalDocID Seek(LocalDocID id);
+  virtual uint32_t Cost() const;
+
+private:
+  PostingList m_list;
+  TokenIntersect m_docs;
+  uint64_t m_fields;
+};
+
+// And of plain terms, left to LookaIntersect and its simd merge.
+class IntersectIterator: public QueryIterator
+{
+public:
+  IntersectIterator(
+    const std::vector<std::string>& tokens, const LookaDictionary* dictionary);
+  virtual ~IntersectIterator();
+
+  virtual LocalDocID Seek(LocalDocID id);
+  virtual uint32_t Cost() const;
+
+private:
+  LookaIntersect m_intersect;
+};
+
+// Docs matching all children and none of the excludes. The children
+// leapfrog each other, the excludes are only probed for their matches.
+class AndIterator: public QueryIterator
+{
+public:
+  AndIterator(
+    const std::vector<QueryIterator*>& children,
+    const std::vector<QueryIterator*>& excludes);
+  virtual ~AndIterator();
+
+  virtual LocalDocID Seek(LocalDocID id);
+  virtual uint32_t Cost() const;
+
+private:
+  std::vector<QueryIterator*> m_children;
+  std::vector<QueryIterator*> m_excludes;
+};
+
+// Docs matching any child, the children are kept in a heap on the doc
+// each of them is at.
+class OrIterator: public QueryIterator
+{
+public:
+  OrIterator(const std::vector<QueryIterator*>& children);
+  virtual ~OrIterator();
+
+  virtual LocalDocID Seek(LocalDocID id);
+  virtual uint32_t Cost() const;
+
+  struct Entry {
+    LocalDocID id;
+    QueryIterator* it;
+  };
+
+private:
+  std::vector<QueryIterator*> m_children;
+  std::vector<Entry> m_heap;
+  LocalDocID m_last_id;
+};
+
+// Docs holding the terms in the same field, one the phrase is searched
+// in, at the same distances as in the query. Candidates come from the intersection of the terms, their
+// positions are checked per field through 256 bit position sets.
+class PhraseIterator: public QueryIterator
+{
+public:
+  PhraseIterator(const QueryNode* node, const LookaDictionary* dictionary);
+  virtual ~PhraseIterator();
+
+  virtual LocalDocID Seek(LocalDocID id);
+  virtual uint32_t Cost() const;
+
+private:
+  bool Match(LocalDocID id);
+
+private:
+  LookaIntersect m_intersect;
+  std::vector<TokenIntersect> m_terms;
+  // distance of every term to the first one, positions are 8 bit
+  std::vector<uint8_t> m_deltas;
+  std::vector<uint64_t> m_positions;
+  uint64_t m_fields;
+};
+
+// Runs a parsed query against a dictionary.
+class LookaQueryExecutor
+{
+public:
+  LookaQueryExecutor();
+  virtual ~LookaQueryExecutor();
+
+  void Build(const QueryNode* root, const LookaDictionary* dictionary);
+  LocalDocID Seek(LocalDocID id);
+
+private:
+  QueryIterator* Create(const QueryNode* node, const LookaDictionary* dictionary);
+
+private:
+  QueryIterator* m_root;
+};
+
+#endif //_LOOKA_QUERY_EXECUTOR_HPP
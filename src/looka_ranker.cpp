@@ -0,0 +1,210 @@
+#include <math.h>
+#include <algorithm>
+#include "looka_ranker.hpp"
+
+///////////////////////////////////////////////////////
+///////////////////////////////////////////////////////
+
+LookaRanker::LookaRanker(): m_norms(NULL), m_doc_num(0)
+{
+}
+
+LookaRanker::~LookaRanker()
+{
+}
+
+void LookaRanker::Init(const LookaNorms* norms)
+{
+  m_norms = norms;
+  m_doc_num = norms ? norms->GetDocNum() : 0;
+  m_inv_norms.clear();
+  if (!norms)
+    return;
+
+  uint32_t field_num = norms->GetFieldNum();
+  m_inv_norms.resize(field_num * (kMaxFieldLength + 1));
+  for (uint32_t f=0; f<field_num; f++) {
+    float avg = norms->GetAvgLength(f);
+    for (uint32_t len=0; len<=kMaxFieldLength; len++) {
+      float norm = 1.0f - kBM25B;
+      if (avg > 0.0f)
+        norm += kBM25B * len / avg;
+      m_inv_norms[f * (kMaxFieldLength + 1) + len] = 1.0f / norm;
+    }
+  }
+}
+
+uint32_t LookaRanker::GetFieldNum() const
+{
+  return m_norms ? m_norms->GetFieldNum() : 0;
+}
+
+float LookaRanker::Idf(uint32_t doc_freq) const
+{
+  float n = static_cast<float>(m_doc_num);
+  float df = static_cast<float>(doc_freq);
+  return logf(1.0f + (n - df + 0.5f) / (df + 0.5f));
+}
+
+float LookaRanker::Weight(
+  LocalDocID id, const HitPos* hits, uint32_t hits_size,
+  const float* field_weights) const
+{
+  if (!hits || !m_norms || id >= m_doc_num)
+    return 0.0f;
+
+  uint32_t field_num = m_norms->GetFieldNum();
+  const char* p = reinterpret_cast<const char*>(hits);
+  const char* end = p + hits_size;
+  float tf = 0.0f;
+  while (p < end) {
+    const HitPos* hit = reinterpret_cast<const HitPos*>(p);
+    if (hit->field < field_num) {
+      float field_tf = hit->count * m_inv_norms[hit->field * (kMaxFieldLength + 1) +
+        m_norms->GetLength(id, hit->field)];
+      tf += field_weights ? field_weights[hit->field] * field_tf : field_tf;
+    }
+    p += sizeof(HitPos) + hit->count * sizeof(uint8_t);
+  }
+  return tf * (kBM25K1 + 1.0f) / (tf + kBM25K1);
+}
+
+float LookaRanker::SetMaxWeights(PostingList& docs) const
+{
+  float max_weight = 0.0f;
+  LocalDocID ids[kPostingBlockSize];
+  for (uint32_t b=0; b<docs.GetBlockNum(); b++) {
+    uint32_t size = docs.DecodeBlock(b, ids);
+    const uint8_t* p = docs.GetBlockHits(b);
+    float block_max = 0.0f;
+    for (uint32_t i=0; i<size; i++) {
+      uint32_t hits_size;
+      p += VByteDecode(p, hits_size);
+      block_max = std::max(block_max,
+        Weight(ids[i], reinterpret_cast<const HitPos*>(p), hits_size));
+      p += hits_size;
+    }
+    docs.SetBlockMaxWeight(b, block_max);
+    max_weight = std::max(max_weight, block_max);
+  }
+  return max_weight;
+}
+
+///////////////////////////////////////////////////////
+///////////////////////////////////////////////////////
+
+LookaScorer::LookaScorer(): m_ranker(NULL), m_lists(NULL)
+{
+}
+
+LookaScorer::~LookaScorer()
+{
+  if (m_lists)
+    delete []m_lists;
+}
+
+void GetFieldWeights(
+  const RankTerm& term, const LookaRanker* ranker, std::vector<float>& weights)
+{
+  weights = term.field_weights;
+  if (!weights.empty())
+    weights.resize(std::max<size_t>(weights.size(), ranker->GetFieldNum()), 0.0f);
+}
+
+void LookaScorer::SetTerms(
+  const std::vector<RankTerm>& terms,
+  const LookaDictionary* dictionary,
+  const LookaRanker* ranker)
+{
+  if (m_lists)
+    delete []m_lists;
+  m_lists = NULL;
+  m_terms.clear();
+  m_idf.clear();
+  m_field_weights.clear();
+  m_ranker = ranker;
+  if (!dictionary || !ranker || terms.empty())
+    return;
+
+  // tokens without postings score nothing
+  m_lists = new PostingList[terms.size()];
+  uint32_t term_num = 0;
+  for (size_t i=0; i<terms.size(); i++) {
+    if (!dictionary->GetPostingList(terms[i].token, m_lists[term_num]))
+      continue;
+    m_field_weights.push_back(std::vector<float>());
+    GetFieldWeights(terms[i], ranker, m_field_weights.back());
+    term_num++;
+  }
+
+  m_terms.resize(term_num);
+  for (uint32_t i=0; i<term_num; i++) {
+    m_terms[i].SetDocs(&m_lists[i]);
+    m_idf.push_back(ranker->Idf(m_lists[i].Size()));
+  }
+}
+
+float LookaScorer::Score(LocalDocID id)
+{
+  float score = 0.0f;
+  if (!m_ranker)
+    return score;
+  for (size_t i=0; i<m_terms.size(); i++) {
+    if (m_terms[i].Seek(id) != id)
+      continue;
+    uint32_t hits_size;
+    const HitPos* hits = m_terms[i].GetHits(hits_size);
+    const std::vector<float>& weights = m_field_weights[i];
+    score += m_ranker->Score(m_idf[i], id, hits, hits_size,
+      weights.empty() ? NULL : &weights[0]);
+  }
+  return score;
+}
+
+///////////////////////////////////////////////////////
+///////////////////////////////////////////////////////
+
+// a ranks before b
+static bool BetterDoc(const ScoredDoc& a, const ScoredDoc& b)
+{
+  return a.score > b.score || (a.score == b.score && a.id < b.id);
+}
+
+LookaTopK::LookaTopK(uint32_t k): m_k(k)
+{
+}
+
+LookaTopK::~LookaTopK()
+{
+}
+
+void LookaTopK::Push(LocalDocID id, float score)
+{
+  if (m_k == 0)
+    return;
+  ScoredDoc doc = {id, score};
+  if (m_heap.size() < m_k) {
+    m_heap.push_back(doc);
+    std::push_heap(m_heap.begin(), m_heap.end(), BetterDoc);
+  } else if (BetterDoc(doc, m_heap.front())) {
+    std::pop_heap(m_heap.begin(), m_heap.end(), BetterDoc);
+    m_heap.back() = doc;
+    std::push_heap(m_heap.begin(), m_heap.end(), BetterDoc);
+  }
+}
+
+float LookaTopK::Threshold() const
+{
+  if (m_k == 0)
+    return INFINITY;
+  if (m_heap.size() < m_k)
+    return -INFINITY;
+  return m_heap.front().score;
+}
+
+void LookaTopK::GetDocs(uint32_t offset, std::vector<LocalDocID>& docs)
+{
+  std::sort_heap(m_heap.begin(), m_heap.end(), BetterDoc);
+  for (size_t i=offset; i<m_heap.size(); i++)
+    docs.push_back(m_heap[i].id);
+}
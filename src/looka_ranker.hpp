@@ -0,0 +1,111 @@
+#ifndef _LOOKA_RANKER_HPP
+#define _LOOKA_RANKER_HPP
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "looka_types.hpp"
+#include "looka_norms.hpp"
+#include "looka_dictionary.hpp"
+#include "looka_intersect.hpp"
+
+const float kBM25K1 = 1.2f;
+const float kBM25B  = 0.75f;
+
+// A token to rank and the weight of every field in its score, in FieldID
+// order. Fields a term is not searched in weigh 0, no weights at all
+// weigh every field 1.
+struct RankTerm {
+  std::string token;
+  std::vector<float> field_weights;
+};
+
+// BM25 over the indexed fields. The term frequency of every field (the
+// HitPos count) is normalised by the field length against its average
+// length, the sum over the fields is saturated with k1 once. The score
+// of a token is its idf times this weight, the weight does not depend on
+// the query so its maxima are stored in the index.
+//
+// Field weights scale the term frequencies before saturation, so with
+// no weight above 1 the stored maxima still bound the weight and with w
+// the largest weight w times them do.
+class LookaRanker
+{
+public:
+  LookaRanker();
+  virtual ~LookaRanker();
+
+  void Init(const LookaNorms* norms);
+
+  uint32_t GetFieldNum() const;
+  float Idf(uint32_t doc_freq) const;
+  float Weight(LocalDocID id, const HitPos* hits, uint32_t hits_size,
+    const float* field_weights = NULL) const;
+  float Score(float idf, LocalDocID id, const HitPos* hits, uint32_t hits_size,
+    const float* field_weights = NULL) const {
+    return idf * Weight(id, hits, hits_size, field_weights);
+  }
+
+  // Fill in the block max weights of a built posting list, returns the
+  // largest of them.
+  float SetMaxWeights(PostingList& docs) const;
+
+private:
+  const LookaNorms* m_norms;
+  uint32_t m_doc_num;
+  // per field and length, 1 / (1 - b + b * length / avg_length)
+  std::vector<float> m_inv_norms;
+};
+
+// Scores the matches of one query, every token reads its hits through a
+// cursor of its own. Docs must be scored in increasing id order.
+class LookaScorer
+{
+public:
+  LookaScorer();
+  virtual ~LookaScorer();
+
+  void SetTerms(
+    const std::vector<RankTerm>& terms,
+    const LookaDictionary* dictionary,
+    const LookaRanker* ranker);
+  float Score(LocalDocID id);
+
+private:
+  const LookaRanker* m_ranker;
+  PostingList* m_lists;
+  std::vector<TokenIntersect> m_terms;
+  std::vector<float> m_idf;
+  std::vector<std::vector<float> > m_field_weights;
+};
+
+// Field weights of a term padded to the fields of the ranker, left empty
+// when every field weighs 1.
+void GetFieldWeights(
+  const RankTerm& term, const LookaRanker* ranker, std::vector<float>& weights);
+
+struct ScoredDoc {
+  LocalDocID id;
+  float score;
+};
+
+// The k best docs seen, kept in a min-heap whose top is the worst of
+// them. Equal scores rank the smaller doc id first.
+class LookaTopK
+{
+public:
+  LookaTopK(uint32_t k);
+  virtual ~LookaTopK();
+
+  void Push(LocalDocID id, float score);
+  // Score a doc has to beat to get in.
+  float Threshold() const;
+  // Docs [offset, k) of the ranking, best first. Call once after the
+  // last Push().
+  void GetDocs(uint32_t offset, std::vector<LocalDocID>& docs);
+
+private:
+  uint32_t m_k;
+  std::vector<ScoredDoc> m_heap;
+};
+
+#endif //_LOOKA_RANKER_HPP
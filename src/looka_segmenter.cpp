@@ -1,12 +1,77 @@
+#include <string.h>
+#include <algorithm>
 #include "looka_segmenter.hpp"
 
+static const char kPunctuation[] =
+  "!@#$%^&*()-=_+`~;:\",./<>?[]{}|\\！￥…（）——【】、：；‘“’”，。《》？·……";
+
+// Decodes the utf-8 code point at s, returns its length or 0 if it is
+// not valid.
+static uint32_t DecodeUtf8(const unsigned char* s, uint32_t len, uint32_t& cp)
+{
+  uint32_t n = s[0] < 0x80 ? 1 : s[0] >= 0xF0 ? 4 : s[0] >= 0xE0 ? 3 :
+    s[0] >= 0xC0 ? 2 : 0;
+  if (n == 0 || n > len)
+    return 0;
+  cp = n == 1 ? s[0] : s[0] & (0x7F >> n);
+  for (uint32_t i=1; i<n; i++) {
+    if ((s[i] & 0xC0) != 0x80)
+      return 0;
+    cp = (cp << 6) | (s[i] & 0x3F);
+  }
+  return n;
+}
+
+// The code points of kPunctuation, a bitmap for ascii and a sorted list
+// for the rest.
+class PunctuationTable
+{
+public:
+  PunctuationTable(const char* chars)
+  {
+    m_ascii[0] = m_ascii[1] = 0;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(chars);
+    uint32_t len = strlen(chars);
+    uint32_t cp, n;
+    for (; len > 0 && (n = DecodeUtf8(p, len, cp)) > 0; p += n, len -= n) {
+      if (cp < 128)
+        m_ascii[cp >> 6] |= 1ULL << (cp & 63);
+      else
+        m_others.push_back(cp);
+    }
+    std::sort(m_others.begin(), m_others.end());
+    m_others.erase(std::unique(m_others.begin(), m_others.end()), m_others.end());
+  }
+
+  bool Has(uint32_t cp) const
+  {
+    if (cp < 128)
+      return (m_ascii[cp >> 6] >> (cp & 63)) & 1;
+    return std::binary_search(m_others.begin(), m_others.end(), cp);
+  }
+
+private:
+  uint64_t m_ascii[2];
+  std::vector<uint32_t> m_others;
+};
+
+static const PunctuationTable kPunctuationTable(kPunctuation);
+
 LookaSegmenter::LookaSegmenter():
-  mInit(false)
+  mInit(false),
+  mForked(false),
+  mSegmenter(NULL),
+  mSegmenterMgr(NULL)
 {
 }
 
 LookaSegmenter::~LookaSegmenter()
 {
+  // a fork owns its segmenter, the others come from the manager pool
+  if (mForked && mSegmenter)
+    delete mSegmenter;
+  if (mSegmenterMgr)
+    delete mSegmenterMgr;
 }
 
 bool LookaSegmenter::Init(const std::string& dict_path)
@@ -24,7 +89,38 @@ bool LookaSegmenter::Init(const std::string& dict_path)
   return mInit;
 }
 
+LookaSegmenter* LookaSegmenter::Fork()
+{
+  if (!mInit || !mSegmenterMgr)
+    return NULL;
+
+  css::Segmenter* segmenter = mSegmenterMgr->getSegmenter(false);
+  if (!segmenter)
+    return NULL;
+  LookaSegmenter* seg = new LookaSegmenter();
+  seg->mSegmenter = segmenter;
+  seg->mForked = true;
+  seg->mInit = true;
+  return seg;
+}
+
 bool LookaSegmenter::Segment(std::string& str, std::vector<SegmentToken>& tokens)
+{
+  std::vector<SegmentSpan> spans;
+  if (!Segment(str.data(), str.length(), spans))
+    return false;
+
+  for (size_t i=0; i<spans.size(); i++) {
+    SegmentToken segTok;
+    segTok.str.assign(str, spans[i].offset, spans[i].len);
+    segTok.pos = spans[i].pos;
+    tokens.push_back(segTok);
+  }
+  return true;
+}
+
+bool LookaSegmenter::Segment(
+  const char* text, uint32_t size, std::vector<SegmentSpan>& spans)
 {
   if (!mInit)
     return false;
@@ -35,21 +131,21 @@ bool LookaSegmenter::Segment(std::string& str, std::vector<SegmentToken>& tokens
   uint32_t  cur_pos = 0;
   u2 len    = 0;
   u2 symlen = 0;
-  mSegmenter->setBuffer((u1*)(str.c_str()), str.length());
+  mSegmenter->setBuffer((u1*)text, size);
   while (true) {
     char* ptr = (char*)mSegmenter->peekToken(len, symlen);
     if (ptr == NULL || len == 0) break;
     mSegmenter->popToken(len);
-    std::string tok = std::string(ptr).substr(0, len);
+    SegmentSpan span;
+    span.offset = ptr - text;
+    span.len = len;
     cur_pos += len;
-    Trim(tok);
-    if (tok.empty()) continue;
-    if (IsPunctuation(tok)) continue;
+    span.pos = cur_pos;
+    Trim(text, span);
+    if (span.len == 0) continue;
+    if (IsPunctuation(text + span.offset, span.len)) continue;
 
-    SegmentToken segTok;
-    segTok.str = tok;
-    segTok.pos = cur_pos;
-    tokens.push_back(segTok);
+    spans.push_back(span);
   }
   return true;
 }
@@ -61,18 +157,27 @@ bool LookaSegmenter::IsSpace(const char& c)
   return false;
 }
 
-bool LookaSegmenter::IsPunctuation(const std::string& token)
+// A token of punctuation code points only.
+bool LookaSegmenter::IsPunctuation(const char* token, uint32_t len)
 {
-  return (punctuation.find(token) != std::string::npos);
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(token);
+  uint32_t cp, n;
+  for (; len > 0; p += n, len -= n)
+    if ((n = DecodeUtf8(p, len, cp)) == 0 || !kPunctuationTable.Has(cp))
+      return false;
+  return true;
 }
 
-void LookaSegmenter::Trim(std::string& s)
+// Cuts the leading and trailing spaces of a span, a span of spaces only
+// keeps the last of them.
+void LookaSegmenter::Trim(const char* text, SegmentSpan& span)
 {
-  if (s.empty())
-    return;
-  std::string::iterator it;
-  for (it=s.begin(); it!=s.end() && IsSpace(*it++););
-  s.erase(s.begin(), --it);
-  for (it=s.end(); it!=s.begin() && IsSpace(*--it););
-  s.erase(++it, s.end());
+  const char* begin = text + span.offset;
+  const char* end = begin + span.len;
+  while (end - begin > 1 && IsSpace(*begin))
+    begin++;
+  while (end - begin > 1 && IsSpace(end[-1]))
+    end--;
+  span.offset = begin - text;
+  span.len = end - begin;
 }
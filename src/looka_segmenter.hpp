@@ -8,16 +8,21 @@
 #include <SegmenterManager.h>
 #include <Segmenter.h>
 
-#define BUFF_SIZE 1*1024*1024
-
-const std::string punctuation = "!@#$%^&*()-=_+`~;:\",./<>?[]{}|\\！￥…（）——【】、：；‘“’”，。《》？·……";
-
 struct SegmentToken
 {
   std::string str;
   uint32_t pos;
 };
 
+// A token as a span of the segmented text. pos is the end offset of the
+// token before trimming, like in SegmentToken.
+struct SegmentSpan
+{
+  uint32_t offset;
+  uint32_t len;
+  uint32_t pos;
+};
+
 class LookaSegmenter
 {
 public:
@@ -26,17 +31,25 @@ public:
 
   bool Init(const std::string& dict_path);
   bool Segment(std::string& str, std::vector<SegmentToken>& tokens);
+  // Appends the tokens of text to spans without copying them, a spans
+  // vector reused across calls makes this allocation free.
+  bool Segment(const char* text, uint32_t size, std::vector<SegmentSpan>& spans);
+
+  // A segmenter of its own sharing the dictionaries of this one, to be
+  // used by another thread. NULL if this one is not initialised. The
+  // fork must be deleted before this one.
+  LookaSegmenter* Fork();
 
 private:
-  void Trim(std::string& s);
+  void Trim(const char* text, SegmentSpan& span);
   bool IsSpace(const char& c);
-  bool IsPunctuation(const std::string& token);
+  bool IsPunctuation(const char* token, uint32_t len);
 
 private:
   bool mInit;
+  bool mForked;
   css::Segmenter* mSegmenter;
   css::SegmenterManager* mSegmenterMgr;
-  char mBuffer[BUFF_SIZE];
 };
 
 #endif //_LOOKA_SEGMENTER_HPP
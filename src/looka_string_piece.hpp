@@ -0,0 +1,44 @@
+#ifndef _LOOKA_STRING_PIECE_HPP
+#define _LOOKA_STRING_PIECE_HPP
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+// Non-owning slice of a string, the bytes must outlive the piece. Used to
+// hand out attribute strings straight from the mapped columns.
+class StringPiece
+{
+public:
+  StringPiece(): m_data(""), m_size(0) {}
+  StringPiece(const char* data, size_t size): m_data(data), m_size(size) {}
+  StringPiece(const std::string& s): m_data(s.data()), m_size(s.size()) {}
+
+  const char* data() const {return m_data;}
+  size_t size() const {return m_size;}
+  bool empty() const {return m_size == 0;}
+  const char* begin() const {return m_data;}
+  const char* end() const {return m_data + m_size;}
+
+  std::string ToString() const {return std::string(m_data, m_size);}
+
+  bool operator == (const StringPiece& s) const {
+    return m_size == s.m_size && memcmp(m_data, s.m_data, m_size) == 0;
+  }
+  bool operator != (const StringPiece& s) const {return !(*this == s);}
+
+  // FNV-1a, for hash sets of pieces
+  struct Hash {
+    size_t operator () (const StringPiece& s) const {
+      uint64_t h = 14695981039346656037ULL;
+      for (size_t i=0; i<s.m_size; i++)
+        h = (h ^ static_cast<uint8_t>(s.m_data[i])) * 1099511628211ULL;
+      return static_cast<size_t>(h);
+    }
+  };
+
+private:
+  const char* m_data;
+  size_t      m_size;
+};
+
+#endif //_LOOKA_STRING_PIECE_HPP
@@ -1,48 +1,6 @@
 #include "looka_types.hpp"
 #include "looka_str2id.hpp"
 
-DocInvert::DocInvert():
-  local_id(kIllegalLocalDocID)/*, tf(0), field_index(-1)*/
-{
-}
-
-DocInvert::DocInvert(LocalDocID id):
-  local_id(id)/*, tf(0), field_index(-1)*/
-{
-}
-
-DocInvert::DocInvert(const DocInvert& d)
-{
-  local_id = d.local_id;
-  //tf = d.tf;
-  //field_index = d.field_index;
-}
-
-DocInvert& DocInvert::operator = (const DocInvert& d)
-{
-  if (!(this == &d)) {
-    local_id = d.local_id;
-    //tf = d.tf;
-    //field_index = d.field_index;
-  }
-  return *this;
-}
-
-bool DocInvert::operator == (const DocInvert& d) const
-{
-  return local_id == d.local_id;
-}
-
-bool DocInvert::operator < (const DocInvert& d) const
-{
-  return local_id < d.local_id;
-}
-
-bool DocInvert::operator > (const DocInvert& d) const
-{
-  return local_id > d.local_id;
-}
-
 Token::Token():
   token_id(kIllegalTokenID),
   token_str("")
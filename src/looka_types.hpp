@@ -27,100 +27,12 @@ enum DocAttrType {
   ATTR_TYPE_STRING,
 };
 
-struct AttrUint {
-  uint8_t size;
-  uint32_t data[];
-};
-
-struct AttrFloat {
-  uint8_t size;
-  float data[];
-};
-
-struct AttrMulti {
-  uint8_t size;
-  uint32_t data[];
-};
-
-struct AttrString {
-  uint8_t  size;
-  union {
-    uint32_t len[];
-    char     data[];
-  };
-
-  std::string GetString(int idx) {
-    std::string s("");
-    if (idx >= 0 && idx < static_cast<int>(size)) {
-      uint32_t pos = size * sizeof(uint32_t);
-      for (int i=0; i<idx; i++)
-        pos += len[i] + 1;
-      s = std::string(data+pos, len[idx]);
-    }
-    return s;
-  }
-};
-
-typedef struct AttrString  AttrNames;
-
-struct DocAttr {
-  AttrUint   *u;
-  AttrFloat  *f;
-  AttrMulti  *m;
-  AttrString *s;
-};
- 
 struct HitPos {
   FieldID field;
   uint8_t count;
   uint8_t pos[];
 };
 
-class DocInvert
-{
-public:
-  DocInvert();
-  DocInvert(LocalDocID id);
-  DocInvert(const DocInvert& d);
-  DocInvert& operator = (const DocInvert& d);
-  bool operator == (const DocInvert& d) const;
-  bool operator < (const DocInvert& d) const;
-  bool operator > (const DocInvert& d) const;
-
-  void SetLocalDocID(LocalDocID id) {local_id = id;}
-  LocalDocID GetLocalDocID() {return local_id;}
-  //void SetTF(uint8_t _tf) {tf = _tf;}
-  //uint8_t GetTF() {return tf;}
-  //void SetFieldIndex(uint8_t idx) {field_index = idx;}
-  //uint8_t GetFieldIndex() {return field_index;}
-
-  void GetHits(std::vector<HitPos*>& h)
-  {
-    int   cur_size = 0;
-    while (cur_size < hits_size) {
-      HitPos* hit = (HitPos*)((char*)hits + cur_size);
-      cur_size += sizeof(HitPos) + hit->count * sizeof(uint8_t);
-      h.push_back(hit);
-    }
-  }
-
-public:
-  struct Hash
-  {
-    size_t operator() (const DocInvert& d) const
-    {
-      DocInvert* p = const_cast<DocInvert*>(&d);
-      return std::hash<LocalDocID>()(p->GetLocalDocID());
-    }
-  };
-
-public:
-  LocalDocID local_id;
-  uint8_t hits_size;
-  HitPos hits[];
-};
-
-
 class Token
 {
 public:
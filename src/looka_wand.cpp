@@ -0,0 +1,145 @@
+#include <algorithm>
+#include "looka_wand.hpp"
+
+LookaWand::LookaWand(): m_ranker(NULL), m_lists(NULL)
+{
+}
+
+LookaWand::~LookaWand()
+{
+  if (m_lists)
+    delete []m_lists;
+}
+
+void LookaWand::SetTokens(
+  const std::vector<RankTerm>& terms,
+  const LookaDictionary* dictionary,
+  const LookaRanker* ranker)
+{
+  if (m_lists)
+    delete []m_lists;
+  m_lists = NULL;
+  m_cursors.clear();
+  m_order.clear();
+  m_ranker = ranker;
+  if (!dictionary || !ranker || terms.empty())
+    return;
+
+  // tokens without postings drop out of the disjunction
+  m_lists = new PostingList[terms.size()];
+  std::vector<const RankTerm*> found;
+  std::vector<float> max_weights;
+  for (size_t i=0; i<terms.size(); i++) {
+    const IndexDictEntry* entry = dictionary->Find(terms[i].token);
+    if (!entry || !dictionary->GetPostingList(terms[i].token, m_lists[found.size()]))
+      continue;
+    found.push_back(&terms[i]);
+    max_weights.push_back(entry->max_weight);
+  }
+
+  m_cursors.resize(found.size());
+  for (size_t i=0; i<m_cursors.size(); i++) {
+    Cursor& c = m_cursors[i];
+    c.docs.SetDocs(&m_lists[i]);
+    c.idf = ranker->Idf(m_lists[i].Size());
+    GetFieldWeights(*found[i], ranker, c.field_weights);
+    float boost = 1.0f;
+    for (size_t j=0; j<c.field_weights.size(); j++)
+      boost = std::max(boost, c.field_weights[j]);
+    c.max_idf = c.idf * boost;
+    c.max_score = c.max_idf * max_weights[i];
+    c.id = c.docs.Seek(0);
+    m_order.push_back(&c);
+  }
+  SortCursors();
+}
+
+void LookaWand::Advance(Cursor* c, LocalDocID id)
+{
+  c->id = id == kIllegalLocalDocID ? id : c->docs.Seek(id);
+}
+
+void LookaWand::SortCursors()
+{
+  // few cursors move at a time, insertion sort keeps this linear
+  for (size_t i=1; i<m_order.size(); i++) {
+    Cursor* c = m_order[i];
+    size_t j = i;
+    for (; j>0 && m_order[j - 1]->id > c->id; j--)
+      m_order[j] = m_order[j - 1];
+    m_order[j] = c;
+  }
+}
+
+LocalDocID LookaWand::Next(float threshold, float& score)
+{
+  size_t n = m_order.size();
+  while (true) {
+    // pivot: the first cursor at which the list max scores exceed the
+    // threshold, no doc before its id can make it
+    float bound = 0.0f;
+    size_t p = n;
+    for (size_t i=0; i<n && m_order[i]->id != kIllegalLocalDocID; i++) {
+      bound += m_order[i]->max_score;
+      if (bound > threshold) {
+        p = i;
+        break;
+      }
+    }
+    if (p == n)
+      return kIllegalLocalDocID;
+    LocalDocID pivot = m_order[p]->id;
+    while (p + 1 < n && m_order[p + 1]->id == pivot)
+      p++;
+
+    // the same with the max scores of the blocks holding the pivot, docs
+    // before the end of the first of these blocks cannot make it either
+    float block_bound = 0.0f;
+    LocalDocID next = p + 1 < n ? m_order[p + 1]->id : kIllegalLocalDocID;
+    for (size_t i=0; i<=p; i++) {
+      const PostingBlock* block = m_order[i]->docs.ShallowSeek(pivot);
+      if (!block)
+        continue;
+      block_bound += m_order[i]->max_idf * block->max_weight;
+      next = std::min(next, block->max_id + 1);
+    }
+    if (block_bound <= threshold) {
+      for (size_t i=0; i<=p; i++)
+        Advance(m_order[i], next);
+      SortCursors();
+      continue;
+    }
+
+    if (m_order[0]->id != pivot) {
+      // move the cursors before the pivot up to it
+      for (size_t i=0; i<p && m_order[i]->id < pivot; i++)
+        Advance(m_order[i], pivot);
+      SortCursors();
+      continue;
+    }
+
+    // sum in query order, ties then rank the same as in LookaScorer
+    score = 0.0f;
+    for (size_t i=0; i<m_cursors.size(); i++) {
+      Cursor& c = m_cursors[i];
+      if (c.id != pivot)
+        continue;
+      uint32_t hits_size;
+      const HitPos* hits = c.docs.GetHits(hits_size);
+      score += m_ranker->Score(c.idf, pivot, hits, hits_size,
+        c.field_weights.empty() ? NULL : &c.field_weights[0]);
+      Advance(&c, pivot + 1);
+    }
+    SortCursors();
+    if (score > threshold)
+      return pivot;
+  }
+}
+
+uint32_t LookaWand::GetMaxListSize() const
+{
+  uint32_t size = 0;
+  for (size_t i=0; i<m_cursors.size(); i++)
+    size = std::max(size, m_lists[i].Size());
+  return size;
+}
@@ -0,0 +1,56 @@
+#ifndef _LOOKA_WAND_HPP
+#define _LOOKA_WAND_HPP
+#include <vector>
+#include "looka_types.hpp"
+#include "looka_postings.hpp"
+#include "looka_dictionary.hpp"
+#include "looka_intersect.hpp"
+#include "looka_ranker.hpp"
+
+// Top-k evaluation of the disjunction of the query tokens with Block-Max
+// WAND. The cursors are kept in doc id order, a doc is only scored once
+// the max scores of the tokens that may hold it, first of whole lists and
+// then of the blocks it would be in, add up to more than the threshold.
+// Everything else is skipped, mostly without decoding it.
+class LookaWand
+{
+public:
+  LookaWand();
+  virtual ~LookaWand();
+
+  void SetTokens(
+    const std::vector<RankTerm>& terms,
+    const LookaDictionary* dictionary,
+    const LookaRanker* ranker);
+
+  // Next doc whose score is above threshold, its score is set in score.
+  // Docs are returned in increasing id order, the threshold may only go
+  // up between calls.
+  LocalDocID Next(float threshold, float& score);
+
+  // Docs in the longest list of the tokens, all of them match the
+  // disjunction.
+  uint32_t GetMaxListSize() const;
+
+private:
+  struct Cursor {
+    TokenIntersect docs;
+    LocalDocID id;
+    float idf;
+    // idf times the largest field weight, if above 1
+    float max_idf;
+    float max_score;
+    std::vector<float> field_weights;
+  };
+
+  void Advance(Cursor* c, LocalDocID id);
+  void SortCursors();
+
+private:
+  const LookaRanker* m_ranker;
+  PostingList* m_lists;
+  std::vector<Cursor>  m_cursors;
+  std::vector<Cursor*> m_order;
+};
+
+#endif //_LOOKA_WAND_HPP
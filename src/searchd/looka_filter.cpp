@@ -0,0 +1,190 @@
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include "looka_filter.hpp"
+
+LookaFilter::LookaFilter(): m_attributes(NULL)
+{
+}
+
+LookaFilter::~LookaFilter()
+{
+}
+
+static bool ParseUint(const std::string& s, uint32_t& v)
+{
+  if (s.empty() || s[0] < '0' || s[0] > '9')
+    return false;
+  char* end;
+  unsigned long n = strtoul(s.c_str(), &end, 10);
+  if (*end != '\0' || n > kuint32max)
+    return false;
+  v = static_cast<uint32_t>(n);
+  return true;
+}
+
+static bool ParseFloat(const std::string& s, float& v)
+{
+  if (s.empty())
+    return false;
+  char* end;
+  v = strtof(s.c_str(), &end);
+  return *end == '\0';
+}
+
+void LookaFilter::Compile(
+  const LookaRequest::Filter_t& filter,
+  const LookaRequest::FilterRange_t& filter_range,
+  const LookaAttributes* attributes)
+{
+  m_attributes = attributes;
+  m_conditions.clear();
+  m_ranges.clear();
+  if (!attributes)
+    return;
+  CompileRanges(filter_range);
+
+  // conditions are filled in place, the string sets point into them
+  m_conditions.resize(filter.size());
+  size_t n = 0;
+  LookaRequest::FilterConstIter_t it;
+  for (it=filter.begin(); it!=filter.end(); ++it) {
+    Condition& c = m_conditions[n];
+    // unknown attributes do not filter
+    if (!attributes->GetAttrIndex(it->first, c.type, c.index))
+      continue;
+
+    const std::vector<std::string>& values = it->second;
+    for (size_t i=0; i<values.size(); i++) {
+      uint32_t u;
+      float f;
+      if (c.type == ATTR_TYPE_UINT || c.type == ATTR_TYPE_MULTI) {
+        if (ParseUint(values[i], u))
+          c.uints.push_back(u);
+      } else if (c.type == ATTR_TYPE_FLOAT) {
+        if (ParseFloat(values[i], f))
+          c.floats.push_back(f);
+      } else if (c.type == ATTR_TYPE_STRING) {
+        c.strings.push_back(values[i]);
+      }
+    }
+    std::sort(c.uints.begin(), c.uints.end());
+    std::sort(c.floats.begin(), c.floats.end());
+    for (size_t i=0; i<c.strings.size(); i++)
+      c.string_set.insert(StringPiece(c.strings[i]));
+    n++;
+  }
+  m_conditions.resize(n);
+}
+
+void LookaFilter::CompileRanges(const LookaRequest::FilterRange_t& filter_range)
+{
+  LookaRequest::FilterRangeConstIter_t it;
+  for (it=filter_range.begin(); it!=filter_range.end(); ++it) {
+    Range r;
+    // ranges apply to uint and float attributes only
+    if (!m_attributes->GetAttrIndex(it->first, r.type, r.index) ||
+      (r.type != ATTR_TYPE_UINT && r.type != ATTR_TYPE_FLOAT))
+      continue;
+
+    const std::vector<std::string>& bounds = it->second;
+    for (size_t i=0; i+1<bounds.size(); i+=2) {
+      const std::string& min = bounds[i];
+      const std::string& max = bounds[i + 1];
+      if (r.type == ATTR_TYPE_UINT) {
+        r.umin = 0;
+        r.umax = kuint32max;
+        if ((!min.empty() && !ParseUint(min, r.umin)) ||
+          (!max.empty() && !ParseUint(max, r.umax)))
+          continue;
+      } else {
+        r.fmin = -INFINITY;
+        r.fmax = INFINITY;
+        if ((!min.empty() && !ParseFloat(min, r.fmin)) ||
+          (!max.empty() && !ParseFloat(max, r.fmax)))
+          continue;
+      }
+      m_ranges.push_back(r);
+    }
+  }
+}
+
+// The checks below run over a whole block: the column values of the ids
+// are gathered and compared without branches, the results of all ranges
+// are and'ed into one mask and the block is compacted once at the end.
+// The compare loops carry no dependencies and vectorise.
+static void MaskUintRange(const uint32_t* column, uint32_t min, uint32_t max,
+  const LocalDocID* ids, uint32_t size, uint8_t* mask)
+{
+  uint32_t values[kFilterBlockSize];
+  for (uint32_t i=0; i<size; i++)
+    values[i] = column[ids[i]];
+  for (uint32_t i=0; i<size; i++)
+    mask[i] &= (values[i] >= min) & (values[i] <= max);
+}
+
+static void MaskFloatRange(const float* column, float min, float max,
+  const LocalDocID* ids, uint32_t size, uint8_t* mask)
+{
+  float values[kFilterBlockSize];
+  for (uint32_t i=0; i<size; i++)
+    values[i] = column[ids[i]];
+  for (uint32_t i=0; i<size; i++)
+    mask[i] &= (values[i] >= min) & (values[i] <= max);
+}
+
+uint32_t LookaFilter::SelectRanges(LocalDocID* ids, uint32_t size) const
+{
+  if (m_ranges.empty())
+    return size;
+
+  uint8_t mask[kFilterBlockSize];
+  memset(mask, 1, size);
+  for (size_t i=0; i<m_ranges.size(); i++) {
+    const Range& r = m_ranges[i];
+    if (r.type == ATTR_TYPE_UINT)
+      MaskUintRange(m_attributes->GetUintColumn(r.index),
+        r.umin, r.umax, ids, size, mask);
+    else
+      MaskFloatRange(m_attributes->GetFloatColumn(r.index),
+        r.fmin, r.fmax, ids, size, mask);
+  }
+
+  uint32_t n = 0;
+  for (uint32_t i=0; i<size; i++) {
+    ids[n] = ids[i];
+    n += mask[i];
+  }
+  return n;
+}
+
+bool LookaFilter::Match(const Condition& c, LocalDocID id) const
+{
+  if (c.type == ATTR_TYPE_UINT) {
+    return std::binary_search(c.uints.begin(), c.uints.end(),
+      m_attributes->GetUint(c.index, id));
+  } else if (c.type == ATTR_TYPE_FLOAT) {
+    return std::binary_search(c.floats.begin(), c.floats.end(),
+      m_attributes->GetFloat(c.index, id));
+  } else if (c.type == ATTR_TYPE_MULTI) {
+    // a multi value attribute matches if any of its values does
+    uint32_t size;
+    const uint32_t* m = m_attributes->GetMulti(c.index, id, size);
+    for (uint32_t i=0; i<size; i++)
+      if (std::binary_search(c.uints.begin(), c.uints.end(), m[i]))
+        return true;
+    return false;
+  } else if (c.type == ATTR_TYPE_STRING) {
+    return c.string_set.count(m_attributes->GetString(c.index, id)) > 0;
+  }
+  return true;
+}
+
+bool LookaFilter::Drop(LocalDocID id) const
+{
+  for (size_t i=0; i<m_conditions.size(); i++)
+    if (!Match(m_conditions[i], id))
+      return true;
+  return false;
+}
@@ -0,0 +1,65 @@
+#ifndef _LOOKA_FILTER_HPP
+#define _LOOKA_FILTER_HPP
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include "../looka_types.hpp"
+#include "../looka_attributes.hpp"
+#include "../looka_string_piece.hpp"
+#include "looka_request.hpp"
+
+// Candidate docs are range checked in blocks of this many ids.
+const uint32_t kFilterBlockSize = 128;
+
+// Filters of one request compiled against the attribute columns. Names
+// are resolved once and the values parsed into typed sets and ranges, so
+// checking a doc only reads its column values.
+class LookaFilter
+{
+public:
+  LookaFilter();
+  virtual ~LookaFilter();
+
+  void Compile(
+    const LookaRequest::Filter_t& filter,
+    const LookaRequest::FilterRange_t& filter_range,
+    const LookaAttributes* attributes);
+
+  // Compacts a block of at most kFilterBlockSize ids to those inside
+  // every range, keeping their order. Returns the number left.
+  uint32_t SelectRanges(LocalDocID* ids, uint32_t size) const;
+
+  // True if the doc fails any value filter.
+  bool Drop(LocalDocID id) const;
+
+  // True if no doc is filtered out.
+  bool Empty() const {return m_conditions.empty() && m_ranges.empty();}
+
+private:
+  struct Condition {
+    DocAttrType type;
+    int index;
+    std::vector<uint32_t> uints;
+    std::vector<float>    floats;
+    std::vector<std::string> strings;
+    std::unordered_set<StringPiece, StringPiece::Hash> string_set;
+  };
+
+  // Inclusive range on a uint or float column.
+  struct Range {
+    DocAttrType type;
+    int index;
+    uint32_t umin, umax;
+    float    fmin, fmax;
+  };
+
+  bool Match(const Condition& c, LocalDocID id) const;
+  void CompileRanges(const LookaRequest::FilterRange_t& filter_range);
+
+private:
+  const LookaAttributes* m_attributes;
+  std::vector<Condition> m_conditions;
+  std::vector<Range>     m_ranges;
+};
+
+#endif //_LOOKA_FILTER_HPP
@@ -0,0 +1,99 @@
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "looka_json_writer.hpp"
+
+static inline bool NeedEscape(unsigned char c)
+{
+  return c < 0x20 || c == '"' || c == '\\';
+}
+
+#ifdef __SSE2__
+size_t LookaJsonWriter::PlainPrefix(const char* s, size_t n)
+{
+  // 16 bytes at a time, a byte is below 0x20 when min(byte, 0x1F) is it
+  size_t i = 0;
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i control = _mm_set1_epi8(0x1F);
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+    __m128i m = _mm_or_si128(
+      _mm_cmpeq_epi8(_mm_min_epu8(v, control), v),
+      _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)));
+    int mask = _mm_movemask_epi8(m);
+    if (mask != 0)
+      return i + __builtin_ctz(mask);
+  }
+  for (; i < n; i++) {
+    if (NeedEscape(static_cast<unsigned char>(s[i])))
+      return i;
+  }
+  return n;
+}
+#else
+size_t LookaJsonWriter::PlainPrefix(const char* s, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    if (NeedEscape(static_cast<unsigned char>(s[i])))
+      return i;
+  }
+  return n;
+}
+#endif
+
+void LookaJsonWriter::AppendString(std::string& out, const char* s, size_t n)
+{
+  static const char* hex = "0123456789ABCDEF";
+  out.push_back('"');
+  while (n > 0) {
+    size_t plain = PlainPrefix(s, n);
+    out.append(s, plain);
+    if (plain == n)
+      break;
+    unsigned char c = static_cast<unsigned char>(s[plain]);
+    switch (c) {
+    case '"':  out.append("\\\""); break;
+    case '\\': out.append("\\\\"); break;
+    case '\b': out.append("\\b"); break;
+    case '\f': out.append("\\f"); break;
+    case '\n': out.append("\\n"); break;
+    case '\r': out.append("\\r"); break;
+    case '\t': out.append("\\t"); break;
+    default: {
+      char u[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+      out.append(u, sizeof(u));
+      break;
+    }
+    }
+    s += plain + 1;
+    n -= plain + 1;
+  }
+  out.push_back('"');
+}
+
+void LookaJsonWriter::AppendUint(std::string& out, uint32_t v)
+{
+  // two digits at a time from the back
+  static const char digits[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+  char buf[16];
+  char* p = buf + sizeof(buf);
+  while (v >= 100) {
+    uint32_t r = (v % 100) * 2;
+    v /= 100;
+    *--p = digits[r + 1];
+    *--p = digits[r];
+  }
+  if (v >= 10) {
+    *--p = digits[v * 2 + 1];
+    *--p = digits[v * 2];
+  } else {
+    *--p = static_cast<char>('0' + v);
+  }
+  out.append(p, buf + sizeof(buf) - p);
+}
@@ -0,0 +1,23 @@
+#ifndef _LOOKA_JSON_WRITER_HPP
+#define _LOOKA_JSON_WRITER_HPP
+#include <stdint.h>
+#include <string>
+
+// The pieces of json text the result packer is made of, appended to a
+// string. Strings are escaped the way jsoncpp escapes them.
+class LookaJsonWriter
+{
+public:
+  // s quoted and escaped, utf-8 is written as it is.
+  static void AppendString(std::string& out, const char* s, size_t n);
+  static void AppendString(std::string& out, const std::string& s) {
+    AppendString(out, s.data(), s.size());
+  }
+  static void AppendUint(std::string& out, uint32_t v);
+
+private:
+  // Length of the prefix of s that needs no escaping.
+  static size_t PlainPrefix(const char* s, size_t n);
+};
+
+#endif //_LOOKA_JSON_WRITER_HPP
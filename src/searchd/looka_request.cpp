@@ -1,5 +1,7 @@
+#include <algorithm>
 #include "looka_request.hpp"
 #include "../looka_string_utils.hpp"
+#include "../http_frame/http_request_parser.hpp"
 
 LookaRequest::LookaRequest()
 {
@@ -7,8 +9,10 @@ LookaRequest::LookaRequest()
   index = "*";
   charset = "utf8";
   dataformat = "xml";
+  match = "all";
   limit = 4000;
   offset = 0;
+  exact_total = false;
 }
 
 LookaRequest::~LookaRequest()
@@ -17,33 +21,41 @@ LookaRequest::~LookaRequest()
 
 bool LookaRequest::Parse(const HttpRequest& request)
 {
-  std::string req_str;
-  if (request.method == "GET") {
-    size_t pos = request.uri.find("/?");
-    if (pos != 0)
+  StringPiece req_str;
+  if (request.method == StringPiece("GET", 3)) {
+    const StringPiece& uri = request.uri;
+    if (uri.size() < 2 || uri.data()[0] != '/' || uri.data()[1] != '?')
       return false;
-    req_str = request.uri.substr(pos + 2);
-  } else if (request.method == "POST") {
+    req_str = StringPiece(uri.data() + 2, uri.size() - 2);
+  } else if (request.method == StringPiece("POST", 4)) {
     req_str = request.content;
   } else {
     return false;
   }
-
-  std::vector<std::pair<std::string, std::string> > pair_params;
-  std::vector<std::string> full_params;
-  splitString(req_str, '&', full_params);
-  if (full_params.empty())
+  if (req_str.empty())
     return false;
-  for (size_t i = 0; i < full_params.size(); i++) {
-    std::string argc, argv;
-    if (!full_params[i].empty() && !xsplit(full_params[i], argc, argv, '='))
-      if (!argc.empty())
-        pair_params.push_back(std::make_pair(argc, argv));
-  }
 
-  for (size_t i = 0; i < pair_params.size(); i++) {
-    std::string key = trim(pair_params[i].first);
-    std::string val = trim(pair_params[i].second);
+  // the pairs are split on the raw string and only then decoded, so an
+  // encoded '&' or '=' stays inside its value
+  std::string key, val;
+  const char* p = req_str.begin();
+  const char* end = req_str.end();
+  while (p < end) {
+    const char* amp = static_cast<const char*>(memchr(p, '&', end - p));
+    if (amp == NULL)
+      amp = end;
+    const char* eq = static_cast<const char*>(memchr(p, '=', amp - p));
+    const char* pair = p;
+    p = amp + 1;
+    if (eq == NULL || eq == pair)
+      continue;
+
+    key.clear();
+    val.clear();
+    HttpRequestParser::UrlDecode(StringPiece(pair, eq - pair), key);
+    HttpRequestParser::UrlDecode(StringPiece(eq + 1, amp - eq - 1), val);
+    key = trim(key);
+    val = trim(val);
     if (key == "query") {
       query = val;
     } else if (key == "index") {
@@ -54,12 +66,18 @@ bool LookaRequest::Parse(const HttpRequest& request)
       charset = val;
     } else if (key == "dataformat") {
       dataformat = toLower(val);
+    } else if (key == "match") {
+      match = toLower(val);
     } else if (key == "offset") {
       offset = atoi(val.c_str());
+    } else if (key == "exact_total") {
+      exact_total = atoi(val.c_str()) != 0;
     } else if (key == "filter") {
       ParseFilter(val);
     } else if (key == "filter_range") {
       ParseFilterRange(val);
+    } else if (key == "field_weights") {
+      ParseFieldWeights(val);
     }
   }
   return true;
@@ -97,5 +115,90 @@ bool LookaRequest::ParseFilter(const std::string& s)
 bool LookaRequest::ParseFilterRange(const std::string& s)
 {
   filter_range_string = s;
-  return false;
+  std::vector<std::string> range_pieces;
+  splitString(filter_range_string, ';', range_pieces);
+  if (range_pieces.empty())
+    return false;
+  for (size_t i = 0; i < range_pieces.size(); i++) {
+    if (range_pieces[i].empty()) continue;
+    std::vector<std::string> kvs;
+    splitString(range_pieces[i], ':', kvs);
+    if (kvs.size() != 2) continue;
+
+    // min,max with either side left empty for an open bound
+    std::string k = kvs[0];
+    std::string min, max;
+    if (xsplit(kvs[1], min, max, ',') != 0) continue;
+
+    // a repeated attribute adds another range, all of them have to hold
+    filter_range[k].push_back(trim(min));
+    filter_range[k].push_back(trim(max));
+  }
+  if (filter_range.size() == 0)
+    return false;
+  return true;
+}
+
+bool LookaRequest::ParseFieldWeights(const std::string& s)
+{
+  field_weights_string = s;
+  std::vector<std::string> weight_pieces;
+  splitString(field_weights_string, ';', weight_pieces);
+  if (weight_pieces.empty())
+    return false;
+  for (size_t i = 0; i < weight_pieces.size(); i++) {
+    if (weight_pieces[i].empty()) continue;
+    std::string k, v;
+    if (xsplit(weight_pieces[i], k, v, ':') != 0) continue;
+
+    // negative weights are ignored
+    float w = static_cast<float>(atof(trim(v).c_str()));
+    if (w < 0.0f) continue;
+    field_weights[trim(k)] = w;
+  }
+  if (field_weights.size() == 0)
+    return false;
+  return true;
+}
+
+static void AppendKeyPart(std::string& key, const std::string& part)
+{
+  key.append(intToString(static_cast<int>(part.size())));
+  key.append(1, ':');
+  key.append(part);
+}
+
+std::string LookaRequest::GetCacheKey() const
+{
+  // length prefixed parts, the query as it is, the maps are already in key
+  // order and the values of a filter are a set
+  std::string key;
+  AppendKeyPart(key, query);
+  AppendKeyPart(key, match);
+  AppendKeyPart(key, dataformat);
+  AppendKeyPart(key, intToString(offset));
+  AppendKeyPart(key, intToString(limit));
+  AppendKeyPart(key, exact_total ? "1" : "0");
+  for (FilterConstIter_t it = filter.begin(); it != filter.end(); ++it) {
+    std::vector<std::string> values(it->second);
+    std::sort(values.begin(), values.end());
+    AppendKeyPart(key, "f");
+    AppendKeyPart(key, it->first);
+    for (size_t i = 0; i < values.size(); i++)
+      AppendKeyPart(key, values[i]);
+  }
+  for (FilterRangeConstIter_t it = filter_range.begin();
+      it != filter_range.end(); ++it) {
+    AppendKeyPart(key, "r");
+    AppendKeyPart(key, it->first);
+    for (size_t i = 0; i < it->second.size(); i++)
+      AppendKeyPart(key, it->second[i]);
+  }
+  std::map<std::string, float>::const_iterator it;
+  for (it = field_weights.begin(); it != field_weights.end(); ++it) {
+    AppendKeyPart(key, "w");
+    AppendKeyPart(key, it->first);
+    key.append(reinterpret_cast<const char*>(&it->second), sizeof(float));
+  }
+  return key;
 }
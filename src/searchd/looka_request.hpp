@@ -14,26 +14,40 @@ public:
   bool Parse(const HttpRequest& request);
   bool ParseFilter(const std::string& filter_string);
   bool ParseFilterRange(const std::string& filter_range_string);
+  bool ParseFieldWeights(const std::string& field_weights_string);
+
+  // The request as it was given, not a normalised form of it: the query is
+  // taken verbatim since the reply echoes it, only the order of the values
+  // of a filter does not matter.
+  std::string GetCacheKey() const;
 
 public:
   std::string query;
   std::string index;
   std::string charset;
   std::string dataformat;
+  std::string match;
   std::string filter_string;
   std::string filter_range_string;
+  std::string field_weights_string;
   int limit;
   int offset;
+  // total_found counted exactly under match=any, else a lower bound
+  bool exact_total;
 
   typedef std::map<std::string, std::vector<std::string> > Filter_t;
   typedef Filter_t::const_iterator FilterConstIter_t;
   typedef Filter_t::iterator FilterIter_t;
   Filter_t filter;
 
+  // per attribute a list of min, max pairs, an empty bound is open
   typedef std::map<std::string, std::vector<std::string> > FilterRange_t;
   typedef FilterRange_t::const_iterator FilterRangeConstIter_t;
   typedef FilterRange_t::iterator FilterRangeIter_t;
   FilterRange_t filter_range;
+
+  // per field name its weight in the score, unnamed fields weigh 1
+  std::map<std::string, float> field_weights;
 };
 
 #endif //_LOOKA_REQUEST_HPP
@@ -0,0 +1,129 @@
+#include <functional>
+#include "looka_result_cache.hpp"
+
+// bookkeeping of an entry besides its strings: list node, index node,
+// the string headers and the shared count, roughly
+static const uint64_t kEntryOverhead = 128;
+
+LookaResultCache::LookaResultCache(uint64_t memory_size, uint32_t shard_num)
+{
+  m_shard_num = shard_num > 0 ? shard_num : 1;
+  m_shard_size = memory_size / m_shard_num;
+  m_shards = new Shard[m_shard_num];
+  for (uint32_t i=0; i<m_shard_num; i++) {
+    pthread_mutex_init(&m_shards[i].lock, NULL);
+    m_shards[i].size = 0;
+    m_shards[i].hits = 0;
+    m_shards[i].misses = 0;
+  }
+}
+
+LookaResultCache::~LookaResultCache()
+{
+  for (uint32_t i=0; i<m_shard_num; i++)
+    pthread_mutex_destroy(&m_shards[i].lock);
+  delete []m_shards;
+}
+
+LookaResultCache::Shard& LookaResultCache::GetShard(const std::string& key)
+{
+  return m_shards[std::hash<std::string>()(key) % m_shard_num];
+}
+
+uint64_t LookaResultCache::EntrySize(const Entry& e)
+{
+  return kEntryOverhead + 2 * e.key.size() + e.reply->size();
+}
+
+bool LookaResultCache::Fits(const std::string& key, size_t reply_size) const
+{
+  return kEntryOverhead + 2 * key.size() + reply_size <= m_shard_size;
+}
+
+bool LookaResultCache::Get(
+  const std::string& key, std::shared_ptr<const std::string>& reply)
+{
+  Shard& shard = GetShard(key);
+  pthread_mutex_lock(&shard.lock);
+  bool found = false;
+  std::unordered_map<std::string, EntryList_t::iterator>::iterator it =
+    shard.index.find(key);
+  if (it != shard.index.end()) {
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    reply = it->second->reply;
+    found = true;
+    shard.hits++;
+  } else {
+    shard.misses++;
+  }
+  pthread_mutex_unlock(&shard.lock);
+  return found;
+}
+
+void LookaResultCache::Put(
+  const std::string& key, const std::shared_ptr<const std::string>& reply)
+{
+  if (!reply || !Fits(key, reply->size()))
+    return;
+  Entry e;
+  e.key = key;
+  e.reply = reply;
+  uint64_t size = EntrySize(e);
+
+  Shard& shard = GetShard(key);
+  pthread_mutex_lock(&shard.lock);
+  std::unordered_map<std::string, EntryList_t::iterator>::iterator it =
+    shard.index.find(key);
+  if (it != shard.index.end()) {
+    // put by another thread that missed at the same time
+    shard.size -= EntrySize(*it->second);
+    shard.entries.erase(it->second);
+    shard.index.erase(it);
+  }
+  while (shard.size + size > m_shard_size && !shard.entries.empty()) {
+    const Entry& last = shard.entries.back();
+    shard.size -= EntrySize(last);
+    shard.index.erase(last.key);
+    shard.entries.pop_back();
+  }
+  shard.entries.push_front(Entry());
+  shard.entries.front().key.swap(e.key);
+  shard.entries.front().reply.swap(e.reply);
+  shard.index[key] = shard.entries.begin();
+  shard.size += size;
+  pthread_mutex_unlock(&shard.lock);
+}
+
+void LookaResultCache::Clear()
+{
+  for (uint32_t i=0; i<m_shard_num; i++) {
+    Shard& shard = m_shards[i];
+    pthread_mutex_lock(&shard.lock);
+    shard.entries.clear();
+    shard.index.clear();
+    shard.size = 0;
+    pthread_mutex_unlock(&shard.lock);
+  }
+}
+
+uint64_t LookaResultCache::GetHits()
+{
+  uint64_t hits = 0;
+  for (uint32_t i=0; i<m_shard_num; i++) {
+    pthread_mutex_lock(&m_shards[i].lock);
+    hits += m_shards[i].hits;
+    pthread_mutex_unlock(&m_shards[i].lock);
+  }
+  return hits;
+}
+
+uint64_t LookaResultCache::GetMisses()
+{
+  uint64_t misses = 0;
+  for (uint32_t i=0; i<m_shard_num; i++) {
+    pthread_mutex_lock(&m_shards[i].lock);
+    misses += m_shards[i].misses;
+    pthread_mutex_unlock(&m_shards[i].lock);
+  }
+  return misses;
+}
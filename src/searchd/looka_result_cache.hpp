@@ -0,0 +1,63 @@
+#ifndef _LOOKA_RESULT_CACHE_HPP
+#define _LOOKA_RESULT_CACHE_HPP
+#include <stdint.h>
+#include <pthread.h>
+#include <string>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+// Packed replies by request key, split over shards that each keep their
+// entries in LRU order under a lock of their own. The memory budget is
+// shared evenly by the shards, a reply larger than the share of a shard
+// is not cached. Replies are shared, not copied, with the requests they
+// are handed to, an entry evicted while being sent stays alive until it
+// is out.
+// Keys are the requests as they were given, see LookaRequest::GetCacheKey.
+// A reply is replayed as it was packed, the costs in it are those of the
+// request that missed.
+class LookaResultCache
+{
+public:
+  LookaResultCache(uint64_t memory_size, uint32_t shard_num = 16);
+  virtual ~LookaResultCache();
+
+  bool Get(const std::string& key, std::shared_ptr<const std::string>& reply);
+  void Put(const std::string& key,
+    const std::shared_ptr<const std::string>& reply);
+  // Whether a reply of reply_size bytes under key would be kept at all,
+  // so that one too large is not put together for nothing.
+  bool Fits(const std::string& key, size_t reply_size) const;
+  // Drops every entry, the counters are kept.
+  void Clear();
+
+  uint64_t GetHits();
+  uint64_t GetMisses();
+
+private:
+  struct Entry {
+    std::string key;
+    std::shared_ptr<const std::string> reply;
+  };
+  typedef std::list<Entry> EntryList_t;
+
+  struct Shard {
+    pthread_mutex_t lock;
+    // most recently used first
+    EntryList_t entries;
+    std::unordered_map<std::string, EntryList_t::iterator> index;
+    uint64_t size;
+    uint64_t hits;
+    uint64_t misses;
+  };
+
+  Shard& GetShard(const std::string& key);
+  static uint64_t EntrySize(const Entry& e);
+
+private:
+  uint64_t m_shard_size;
+  uint32_t m_shard_num;
+  Shard* m_shards;
+};
+
+#endif //_LOOKA_RESULT_CACHE_HPP
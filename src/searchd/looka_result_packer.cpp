@@ -1,199 +1,343 @@
+#include <errno.h>
+#include <stdio.h>
 #include <string.h>
-#include <json/json.h>
-#include <libxml/parser.h>
+#include <map>
 #include "looka_result_packer.hpp"
+#include "looka_json_writer.hpp"
 
-std::string LookaResultPacker::PackResult(
-  const LookaConfigSource* source,
+// Length of the utf-8 char at s and its code point, 0 if it is broken.
+static size_t DecodeUtf8(const char* s, size_t n, uint32_t& cp)
+{
+  const unsigned char* u = reinterpret_cast<const unsigned char*>(s);
+  size_t len = u[0] >= 0xF0 ? 4 : u[0] >= 0xE0 ? 3 : u[0] >= 0xC0 ? 2 : 0;
+  if (len == 0 || len > n)
+    return 0;
+  cp = u[0] & (0xFF >> (len + 1));
+  for (size_t i = 1; i < len; i++) {
+    if ((u[i] & 0xC0) != 0x80)
+      return 0;
+    cp = (cp << 6) | (u[i] & 0x3F);
+  }
+  return len;
+}
+
+void LookaResultPacker::GetSummary(
   const std::string& query,
-  const std::vector<std::string> strtokens,
-  const std::vector<DocAttr*>& docs,
-  const std::map<DocAttrType, AttrNames*>* attrnames,
-  const LookaIntersect* intersect,
-  const LookaInverter<Token, DocInvert*>* inverter,
+  size_t doc_num,
   const std::vector<std::pair<std::string, std::string> >& extra,
-  int&  wastetime_us)
+  std::vector<std::pair<std::string, std::string> >& summary)
 {
-  std::vector<std::pair<std::string, std::string> > summary;
+  summary.clear();
   summary.push_back(std::make_pair("query", query));
   summary.push_back(
-    std::make_pair("doc_num", intToString(static_cast<int>(docs.size()))));
+    std::make_pair("doc_num", intToString(static_cast<int>(doc_num))));
   std::copy(extra.begin(), extra.end(), std::back_inserter(summary));
-
-  return PackResultInternal(source, summary, docs, attrnames, wastetime_us);
 }
 
-bool LookaResultPacker::GetAttrNameIndex(
-  const std::map<DocAttrType, AttrNames*>* attrnames,
-  const std::string& s, DocAttrType& type, int& index)
+////////////////////////////////////////////////////////////////////////////////
+// The members of an object are sorted by name, as jsoncpp keeps them. Styled,
+// they are indented by three spaces and the docs array has an item a line.
+
+LookaResultJsonPacker::LookaResultJsonPacker(
+  const LookaConfigSource* source, bool styled): m_styled(styled)
 {
-  if (!attrnames)
-    return false;
-  if (s.empty())
-    return false;
+  std::map<std::string, Column> columns;
+  for (size_t j=0; j<source->sql_attr_uint.size(); j++)
+    columns[source->sql_attr_uint[j]].is_uint = true;
+  for (size_t j=0; j<source->sql_attr_string.size(); j++)
+    columns[source->sql_attr_string[j]].is_string = true;
 
-  bool found = false;
-  std::map<DocAttrType, AttrNames*>::const_iterator it = attrnames->begin();
-  for (it; it != attrnames->end(); ++it) {
-    AttrNames*& attr = const_cast<AttrNames*&>(it->second);
-    for (uint8_t i=0; i<attr->size; i++) {
-      if (attr->GetString(i) == s) {
-        type = it->first;
-        index = static_cast<int>(i);
-        found = true;
-        break;
-      }
-    }
+  std::map<std::string, Column>::iterator it;
+  for (it = columns.begin(); it != columns.end(); ++it) {
+    Column c = it->second;
+    c.name = it->first;
+    c.key = m_styled ? "         " : "";
+    LookaJsonWriter::AppendString(c.key, c.name);
+    c.key.append(m_styled ? " : " : ":");
+    m_columns.push_back(c);
   }
-  return found;
 }
 
-std::string LookaResultJsonPacker::PackResultInternal(
-  const LookaConfigSource* source,
+void LookaResultJsonPacker::AppendMember(std::string& out,
+  const std::string& name, const std::string& value, bool last)
+{
+  if (m_styled)
+    out.append("   ");
+  LookaJsonWriter::AppendString(out, name);
+  out.append(m_styled ? " : " : ":");
+  LookaJsonWriter::AppendString(out, value);
+  if (!last)
+    out.push_back(',');
+  if (m_styled)
+    out.push_back('\n');
+}
+
+void LookaResultJsonPacker::GetMembers(
   const std::vector<std::pair<std::string, std::string> >& summary,
-  const std::vector<DocAttr*>& docs,
-  const std::map<DocAttrType, AttrNames*>* attrnames,
-  int&  wastetime_us)
+  std::map<std::string, std::string>& members)
 {
-  struct timeval pack_start;
-  gettimeofday(&pack_start, NULL);
+  for (size_t i=0; i<summary.size(); i++)
+    members[summary[i].first] = summary[i].second;
+  members.erase("docs");
+  members.erase("pack_cost");
+}
 
-  Json::Value root;
-  Json::Value jsonDocs;
-  Json::Value item;
-  for (size_t i=0; i<summary.size(); i++) {
-    const std::pair<std::string, std::string>& kvpair = summary[i];
-    const std::string& k = kvpair.first;
-    const std::string& v = kvpair.second;
-    root[k] = v;
-  }
+void LookaResultJsonPacker::PackHead(
+  const std::vector<std::pair<std::string, std::string> >& summary,
+  size_t doc_num,
+  LookaOutputBuffer& out)
+{
+  std::map<std::string, std::string> members;
+  GetMembers(summary, members);
+
+  std::string text = m_styled ? "{\n" : "{";
+  std::map<std::string, std::string>::const_iterator it = members.begin();
+  for (; it != members.end() && it->first < "docs"; ++it)
+    AppendMember(text, it->first, it->second, false);
 
+  text.append(m_styled ? "   \"docs\" : " : "\"docs\":");
+  if (doc_num == 0)
+    text.append(m_styled ? "null,\n" : "null,");
+  else
+    text.append(m_styled ? "[\n" : "[");
+  out.Append(text);
+}
+
+void LookaResultJsonPacker::PackDocs(
+  const LookaConfigSource* source,
+  const std::vector<LocalDocID>& docs,
+  size_t begin,
+  size_t end,
+  const LookaAttributes* attributes,
+  LookaOutputBuffer& out)
+{
+  // the columns the attributes have with the type they are listed with
   int idx;
   DocAttrType type;
-  for (size_t i=0; i<docs.size(); i++) {
-    DocAttr* const& attr = docs[i];
-    for (size_t j=0; j<source->sql_attr_uint.size(); j++) {
-      if (GetAttrNameIndex(attrnames, source->sql_attr_uint[j], type, idx) &&
-        type == ATTR_TYPE_UINT) {
-        item[source->sql_attr_uint[j]] = attr->u->data[idx];
+  std::vector<const Column*> columns;
+  std::vector<std::pair<DocAttrType, int> > attrs;
+  for (size_t j=0; j<m_columns.size(); j++) {
+    const Column& c = m_columns[j];
+    if (!attributes->GetAttrIndex(c.name, type, idx))
+      continue;
+    if ((type == ATTR_TYPE_UINT && c.is_uint) ||
+        (type == ATTR_TYPE_STRING && c.is_string)) {
+      columns.push_back(&c);
+      attrs.push_back(std::make_pair(type, idx));
+    }
+  }
+
+  std::string text;
+  for (size_t i=begin; i<end && i<docs.size(); i++) {
+    LocalDocID id = docs[i];
+    if (m_styled)
+      text.append("      ");
+    if (columns.empty()) {
+      text.append("null");
+    } else {
+      text.append(m_styled ? "{\n" : "{");
+      for (size_t j=0; j<columns.size(); j++) {
+        text.append(columns[j]->key);
+        if (attrs[j].first == ATTR_TYPE_UINT) {
+          LookaJsonWriter::AppendUint(text,
+            attributes->GetUint(attrs[j].second, id));
+        } else {
+          StringPiece s = attributes->GetString(attrs[j].second, id);
+          LookaJsonWriter::AppendString(text, s.data(), s.size());
+        }
+        if (j + 1 < columns.size())
+          text.push_back(',');
+        if (m_styled)
+          text.push_back('\n');
       }
+      text.append(m_styled ? "      }" : "}");
     }
-    for (size_t j=0; j<source->sql_attr_string.size(); j++) {
-      if (GetAttrNameIndex(attrnames, source->sql_attr_string[j], type, idx) &&
-        type == ATTR_TYPE_STRING) {
-        item[source->sql_attr_string[j]] = attr->s->GetString(idx);
+    if (i + 1 < docs.size())
+      text.append(m_styled ? ",\n" : ",");
+    else
+      text.append(m_styled ? "\n   ],\n" : "],");
+    // written out doc by doc, only the chunks grow with the result
+    out.Append(text);
+    text.clear();
+  }
+}
+
+void LookaResultJsonPacker::PackTail(
+  const std::vector<std::pair<std::string, std::string> >& summary,
+  size_t doc_num,
+  const std::string& pack_cost,
+  LookaOutputBuffer& out)
+{
+  std::map<std::string, std::string> members;
+  GetMembers(summary, members);
+  members["pack_cost"] = pack_cost;
+
+  std::string text;
+  std::map<std::string, std::string>::const_iterator it;
+  for (it = members.upper_bound("docs"); it != members.end(); ++it) {
+    std::map<std::string, std::string>::const_iterator next = it;
+    AppendMember(text, it->first, it->second, ++next == members.end());
+  }
+  text.append("}\n");
+  out.Append(text);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The xml is written the way libxml dumps a document formatted in gbk: two
+// spaces of indent, text escaped, chars gbk has not as char references.
+
+void LookaResultXmlPacker::AppendText(
+  std::string& out, iconv_t cd, const char* s, size_t n)
+{
+  const char* end = s + n;
+  char buf[256];
+  while (s < end) {
+    unsigned char c = static_cast<unsigned char>(*s);
+    if (c < 0x80) {
+      switch (c) {
+      case '&':  out.append("&amp;"); break;
+      case '<':  out.append("&lt;"); break;
+      case '>':  out.append("&gt;"); break;
+      case '\r': out.append("&#13;"); break;
+      default:   out.push_back(*s); break;
       }
+      s++;
+      continue;
     }
-    /*
-    for (size_t j=0; j<attr->u->size; j++) {
-      item[source->sql_attr_uint[j]] = attr->u->data[j];
+
+    // a run of multibyte chars is converted at once
+    const char* run = s;
+    while (s < end && static_cast<unsigned char>(*s) >= 0x80)
+      s++;
+    char* in = const_cast<char*>(run);
+    size_t in_left = s - run;
+    if (cd == (iconv_t)-1) {
+      out.append(run, in_left);
+      continue;
     }
-    for (size_t j=0; j<attr->s->size; j++) {
-      item[source->sql_attr_string[j]] = attr->s->GetString(j);
+    while (in_left > 0) {
+      char* o = buf;
+      size_t o_left = sizeof(buf);
+      size_t r = iconv(cd, &in, &in_left, &o, &o_left);
+      out.append(buf, o - buf);
+      if (r != (size_t)-1 || errno == E2BIG)
+        continue;
+      uint32_t cp;
+      size_t len = DecodeUtf8(in, in_left, cp);
+      if (len > 0) {
+        char ref[16];
+        out.append(ref, snprintf(ref, sizeof(ref), "&#%u;", cp));
+      }
+      // a broken byte is dropped
+      len = std::max(len, (size_t)1);
+      in += len;
+      in_left -= len;
     }
-    */
-    jsonDocs.append(item);
   }
-  root["docs"] = jsonDocs;
+}
 
-  wastetime_us = WASTE_TIME_US(pack_start);
-  std::string pack_cost_str = intToString(wastetime_us) + "us";
-  root["pack_cost"] = pack_cost_str;
-  return root.toStyledString();
+void LookaResultXmlPacker::AppendElement(std::string& out, iconv_t cd,
+  const char* indent, const std::string& tag, const char* s, size_t n)
+{
+  out.append(indent);
+  out.push_back('<');
+  out.append(tag);
+  out.push_back('>');
+  AppendText(out, cd, s, n);
+  out.append("</");
+  out.append(tag);
+  out.append(">\n");
 }
 
-std::string LookaResultXmlPacker::PackResultInternal(
-  const LookaConfigSource* source,
+void LookaResultXmlPacker::PackHead(
   const std::vector<std::pair<std::string, std::string> >& summary,
-  const std::vector<DocAttr*>& docs,
-  const std::map<DocAttrType, AttrNames*>* attrnames,
-  int&  wastetime_us)
+  size_t doc_num,
+  LookaOutputBuffer& out)
 {
-  struct timeval pack_start;
-  gettimeofday(&pack_start, NULL);
-
-  std::string xmlresult;
-  xmlDocPtr  document = xmlNewDoc(BAD_CAST("1.0"));
-  xmlNodePtr display  = xmlNewNode(NULL, BAD_CAST("display"));
-  xmlDocSetRootElement(document, display);
-
+  iconv_t cd = iconv_open("GBK", "UTF-8");
+  std::string head = "<?xml version=\"1.0\" encoding=\"gbk\"?>\n<display>\n";
   for (size_t i=0; i<summary.size(); i++) {
-    const std::pair<std::string, std::string>& kvpair = summary[i];
-    const std::string& k = kvpair.first;
-    const std::string& v = kvpair.second;
-    xmlNewTextChild(display, NULL,
-      BAD_CAST(const_cast<char*>(k.c_str())),
-      BAD_CAST(const_cast<char*>(v.c_str())));
+    const std::string& k = summary[i].first;
+    const std::string& v = summary[i].second;
+    AppendElement(head, cd, "  ", k, v.data(), v.size());
   }
+  head.append(doc_num == 0 ? "  <docs/>\n" : "  <docs>\n");
+  if (cd != (iconv_t)-1)
+    iconv_close(cd);
+  out.Append(head);
+}
 
+void LookaResultXmlPacker::PackDocs(
+  const LookaConfigSource* source,
+  const std::vector<LocalDocID>& docs,
+  size_t begin,
+  size_t end,
+  const LookaAttributes* attributes,
+  LookaOutputBuffer& out)
+{
   int idx;
   DocAttrType type;
-  xmlNodePtr docs_root = xmlNewNode(NULL, BAD_CAST("docs"));
-  for (size_t i=0; i<docs.size(); i++) {
-    xmlNodePtr item = xmlNewNode(NULL, BAD_CAST("item"));
-    DocAttr* const& attr = docs[i];
-    std::string tag, val;
-    for (size_t j=0; j<source->sql_attr_uint.size(); j++) {
-      if (GetAttrNameIndex(attrnames, source->sql_attr_uint[j], type, idx) &&
-        type == ATTR_TYPE_UINT) {
-        tag = source->sql_attr_uint[j];
-        val = intToString(static_cast<int>(attr->u->data[idx]));
-        xmlNewTextChild(item, NULL,
-          BAD_CAST(const_cast<char*>(tag.c_str())),
-          BAD_CAST(const_cast<char*>(val.c_str())));
-      }
-    }
-    for (size_t j=0; j<source->sql_attr_string.size(); j++) {
-      if (GetAttrNameIndex(attrnames, source->sql_attr_string[j], type, idx) &&
-        type == ATTR_TYPE_STRING) {
-        tag = source->sql_attr_string[j];
-        val = attr->s->GetString(idx);
-        xmlNewTextChild(item, NULL,
-          BAD_CAST(const_cast<char*>(tag.c_str())),
-          BAD_CAST(const_cast<char*>(val.c_str())));
-      }
+  std::vector<std::pair<std::string, int> > uint_attrs;
+  std::vector<std::pair<std::string, int> > string_attrs;
+  for (size_t j=0; j<source->sql_attr_uint.size(); j++) {
+    const std::string& name = source->sql_attr_uint[j];
+    if (attributes->GetAttrIndex(name, type, idx) && type == ATTR_TYPE_UINT)
+      uint_attrs.push_back(std::make_pair(name, idx));
+  }
+  for (size_t j=0; j<source->sql_attr_string.size(); j++) {
+    const std::string& name = source->sql_attr_string[j];
+    if (attributes->GetAttrIndex(name, type, idx) && type == ATTR_TYPE_STRING)
+      string_attrs.push_back(std::make_pair(name, idx));
+  }
+
+  iconv_t cd = iconv_open("GBK", "UTF-8");
+  std::string item;
+  char val[16];
+  for (size_t i=begin; i<end && i<docs.size(); i++) {
+    LocalDocID id = docs[i];
+    if (uint_attrs.empty() && string_attrs.empty()) {
+      out.Append("    <item/>\n");
+      continue;
     }
-    /*
-    for (size_t j=0; j<attr->s->size; j++) {
-      tag = source->sql_attr_string[j];
-      val = attr->s->GetString(j);
-      xmlNewTextChild(item, NULL,
-        BAD_CAST(const_cast<char*>(tag.c_str())),
-        BAD_CAST(const_cast<char*>(val.c_str())));
+    item.assign("    <item>\n");
+    for (size_t j=0; j<uint_attrs.size(); j++) {
+      uint32_t v = attributes->GetUint(uint_attrs[j].second, id);
+      int n = snprintf(val, sizeof(val), "%d", static_cast<int>(v));
+      AppendElement(item, cd, "      ", uint_attrs[j].first, val, n);
     }
-    for (size_t j=0; j<attr->u->size; j++) {
-      tag = source->sql_attr_uint[j];
-      val = intToString(static_cast<int>(attr->u->data[j]));
-      xmlNewTextChild(item, NULL,
-        BAD_CAST(const_cast<char*>(tag.c_str())),
-        BAD_CAST(const_cast<char*>(val.c_str())));
+    for (size_t j=0; j<string_attrs.size(); j++) {
+      StringPiece s = attributes->GetString(string_attrs[j].second, id);
+      AppendElement(item, cd, "      ", string_attrs[j].first,
+        s.data(), s.size());
     }
-    */
-    xmlAddChild(docs_root, item);
+    item.append("    </item>\n");
+    out.Append(item);
   }
+  if (cd != (iconv_t)-1)
+    iconv_close(cd);
+}
 
-  wastetime_us = WASTE_TIME_US(pack_start);
-  std::string pack_cost_str = intToString(wastetime_us) + "us";
-  xmlNewTextChild(display, NULL,
-    BAD_CAST("pack_cost"),
-    BAD_CAST(const_cast<char*>(pack_cost_str.c_str())));
-
-  xmlAddChild(display, docs_root);
-
-  xmlChar* doc_text;
-  int doc_len;
-  xmlDocDumpFormatMemoryEnc(document, &doc_text, &doc_len, "gbk", 1);
-
-  xmlresult = std::string((char*)doc_text, doc_len);
-  xmlFree(doc_text);
-
-  return xmlresult;
+void LookaResultXmlPacker::PackTail(
+  const std::vector<std::pair<std::string, std::string> >& summary,
+  size_t doc_num,
+  const std::string& pack_cost,
+  LookaOutputBuffer& out)
+{
+  // pack_cost is only known once the docs are out, so it follows them
+  std::string tail;
+  if (doc_num > 0)
+    tail.append("  </docs>\n");
+  AppendElement(tail, (iconv_t)-1, "  ", "pack_cost",
+    pack_cost.data(), pack_cost.size());
+  tail.append("</display>\n");
+  out.Append(tail);
 }
 
-LookaResultPackerWrapper::LookaResultPackerWrapper()
+LookaResultPackerWrapper::LookaResultPackerWrapper(
+  const LookaConfigSource* source, bool json_styled)
 {
   m_basic_packer = new LookaResultBasicPacker();
-  m_json_packer  = new LookaResultJsonPacker();
+  m_json_packer  = new LookaResultJsonPacker(source, json_styled);
   m_xml_packer   = new LookaResultXmlPacker();
 }
 
@@ -1,43 +1,53 @@
 #ifndef _LOOKA_RESULT_PACKER_HPP
 #define _LOOKA_RESULT_PACKER_HPP
 
+#include <iconv.h>
 #include <vector>
 #include <string>
+#include <map>
 #include "../looka_log.hpp"
 #include "../looka_string_utils.hpp"
 #include "../looka_types.hpp"
 #include "../looka_config_source.hpp"
-#include "../looka_inverter.hpp"
-#include "../looka_intersect.hpp"
+#include "../looka_dictionary.hpp"
+#include "../looka_attributes.hpp"
+#include "../looka_output_buffer.hpp"
 
 class LookaResultPacker
 {
 public:
   LookaResultPacker() {}
   virtual ~LookaResultPacker() {}
-  
-  virtual std::string PackResult(
-    const LookaConfigSource* source,
+
+  // The summary of a result: the query, the number of docs and extra.
+  static void GetSummary(
     const std::string& query,
-    const std::vector<std::string> strtokens,
-    const std::vector<DocAttr*>& docs,
-    const std::map<DocAttrType, AttrNames*>* attrnames,
-    const LookaIntersect* intersect,
-    const LookaInverter<Token, DocInvert*>* inverter,
+    size_t doc_num,
     const std::vector<std::pair<std::string, std::string> >& extra,
-    int&  wastetime_us);
+    std::vector<std::pair<std::string, std::string> >& summary);
 
-  virtual std::string PackResultInternal(
+  // A result is packed in parts appended to out, so that it can be sent
+  // while it is packed: the head with the summary, the docs from begin to
+  // end, as many times as it takes, and the tail with the time packing
+  // took. No document tree of the result is built.
+  virtual void PackHead(
+    const std::vector<std::pair<std::string, std::string> >& summary,
+    size_t doc_num,
+    LookaOutputBuffer& out) = 0;
+
+  virtual void PackDocs(
     const LookaConfigSource* source,
+    const std::vector<LocalDocID>& docs,
+    size_t begin,
+    size_t end,
+    const LookaAttributes* attributes,
+    LookaOutputBuffer& out) = 0;
+
+  virtual void PackTail(
     const std::vector<std::pair<std::string, std::string> >& summary,
-    const std::vector<DocAttr*>& docs,
-    const std::map<DocAttrType, AttrNames*>* attrnames,
-    int&  wastetime_us) = 0;
-
-protected:
-  bool GetAttrNameIndex(
-    const std::map<DocAttrType, AttrNames*>* attrnames,
-    const std::string& s, DocAttrType& type, int& index);
+    size_t doc_num,
+    const std::string& pack_cost,
+    LookaOutputBuffer& out) = 0;
 };
 
 class LookaResultBasicPacker: public LookaResultPacker
@@ -46,49 +56,117 @@ public:
   LookaResultBasicPacker() {}
   virtual ~LookaResultBasicPacker() {}
 
-  virtual std::string PackResultInternal(
+  virtual void PackHead(
+    const std::vector<std::pair<std::string, std::string> >& summary,
+    size_t doc_num,
+    LookaOutputBuffer& out)
+  {
+  }
+
+  virtual void PackDocs(
     const LookaConfigSource* source,
+    const std::vector<LocalDocID>& docs,
+    size_t begin,
+    size_t end,
+    const LookaAttributes* attributes,
+    LookaOutputBuffer& out)
+  {
+  }
+
+  virtual void PackTail(
     const std::vector<std::pair<std::string, std::string> >& summary,
-    const std::vector<DocAttr*>& docs,
-    const std::map<DocAttrType, AttrNames*>* attrnames,
-    int&  wastetime_us)
+    size_t doc_num,
+    const std::string& pack_cost,
+    LookaOutputBuffer& out)
   {
-    return "";
   }
 };
 
+// Compact json, or laid out the way Json::StyledWriter writes it when
+// styled. The member names of the attributes of source are escaped once,
+// when the packer is made.
 class LookaResultJsonPacker: public LookaResultPacker
 {
 public:
-  LookaResultJsonPacker() {}
+  LookaResultJsonPacker(const LookaConfigSource* source, bool styled);
   virtual ~LookaResultJsonPacker() {}
 
-  virtual std::string PackResultInternal(
+  virtual void PackHead(
+    const std::vector<std::pair<std::string, std::string> >& summary,
+    size_t doc_num,
+    LookaOutputBuffer& out);
+
+  virtual void PackDocs(
     const LookaConfigSource* source,
+    const std::vector<LocalDocID>& docs,
+    size_t begin,
+    size_t end,
+    const LookaAttributes* attributes,
+    LookaOutputBuffer& out);
+
+  virtual void PackTail(
     const std::vector<std::pair<std::string, std::string> >& summary,
-    const std::vector<DocAttr*>& docs,
-    const std::map<DocAttrType, AttrNames*>* attrnames,
-    int&  wastetime_us);
+    size_t doc_num,
+    const std::string& pack_cost,
+    LookaOutputBuffer& out);
+
+private:
+  static void GetMembers(
+    const std::vector<std::pair<std::string, std::string> >& summary,
+    std::map<std::string, std::string>& members);
+  void AppendMember(std::string& out,
+    const std::string& name, const std::string& value, bool last);
+
+private:
+  // an attribute of the docs, sorted by name like jsoncpp members
+  struct Column {
+    std::string name;
+    bool is_uint;
+    bool is_string;
+    // the quoted name and the separator after it
+    std::string key;
+    Column(): is_uint(false), is_string(false) {}
+  };
+  std::vector<Column> m_columns;
+  bool m_styled;
 };
 
+// The head holds the summary, pack_cost follows the docs.
 class LookaResultXmlPacker: public LookaResultPacker
 {
 public:
   LookaResultXmlPacker() {}
   virtual ~LookaResultXmlPacker() {}
 
-  virtual std::string PackResultInternal(
+  virtual void PackHead(
+    const std::vector<std::pair<std::string, std::string> >& summary,
+    size_t doc_num,
+    LookaOutputBuffer& out);
+
+  virtual void PackDocs(
     const LookaConfigSource* source,
+    const std::vector<LocalDocID>& docs,
+    size_t begin,
+    size_t end,
+    const LookaAttributes* attributes,
+    LookaOutputBuffer& out);
+
+  virtual void PackTail(
     const std::vector<std::pair<std::string, std::string> >& summary,
-    const std::vector<DocAttr*>& docs,
-    const std::map<DocAttrType, AttrNames*>* attrnames,
-    int&  wastetime_us);
+    size_t doc_num,
+    const std::string& pack_cost,
+    LookaOutputBuffer& out);
+
+private:
+  static void AppendText(std::string& out, iconv_t cd, const char* s, size_t n);
+  static void AppendElement(std::string& out, iconv_t cd,
+    const char* indent, const std::string& tag, const char* s, size_t n);
 };
 
 class LookaResultPackerWrapper
 {
 public:
-  LookaResultPackerWrapper();
+  LookaResultPackerWrapper(const LookaConfigSource* source, bool json_styled);
   virtual ~LookaResultPackerWrapper();
   
   LookaResultPacker* GetResultPacker(const std::string& format);
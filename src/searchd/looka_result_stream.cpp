@@ -0,0 +1,112 @@
+#include <sys/time.h>
+#include <algorithm>
+#include <utility>
+#include "../looka_log.hpp"
+#include "../looka_string_utils.hpp"
+#include "looka_result_stream.hpp"
+
+LookaResultStream::LookaResultStream(
+  LookaResultPacker* packer,
+  const LookaConfigSource* source,
+  const LookaAttributes* attributes):
+  m_packer(packer), m_source(source), m_attributes(attributes),
+  m_state(STREAM_HEAD), m_pos(0), m_wastetime_pack(0), m_cache(NULL),
+  m_wastetime_parse(0), m_wastetime_segment(0), m_wastetime_search(0)
+{
+}
+
+LookaResultStream::~LookaResultStream()
+{
+  if (m_log.empty())
+    return;
+  _INFO("%s [cost(%d %d %d %d) %dus]%s",
+    m_log.c_str(),
+    m_wastetime_parse,
+    m_wastetime_segment,
+    m_wastetime_search,
+    m_wastetime_pack,
+    m_wastetime_parse + m_wastetime_segment + m_wastetime_search +
+      m_wastetime_pack,
+    m_state == STREAM_DONE ? "" : " [unfinished]");
+}
+
+void LookaResultStream::SetResult(
+  const std::string& query,
+  std::vector<LocalDocID>& docs,
+  const std::vector<std::pair<std::string, std::string> >& extra)
+{
+  m_docs.swap(docs);
+  docs.clear();
+  LookaResultPacker::GetSummary(query, m_docs.size(), extra, m_summary);
+}
+
+void LookaResultStream::SetCache(
+  LookaResultCache* cache, const std::string& key)
+{
+  m_cache = cache;
+  m_cache_key = key;
+}
+
+void LookaResultStream::SetLog(const std::string& log,
+  int wastetime_parse, int wastetime_segment, int wastetime_search)
+{
+  m_log = log;
+  m_wastetime_parse = wastetime_parse;
+  m_wastetime_segment = wastetime_segment;
+  m_wastetime_search = wastetime_search;
+}
+
+bool LookaResultStream::Next(LookaOutputBuffer& out)
+{
+  if (m_state == STREAM_DONE)
+    return false;
+
+  struct timeval pack_start;
+  gettimeofday(&pack_start, NULL);
+  size_t from = out.size();
+  if (m_state == STREAM_HEAD) {
+    m_packer->PackHead(m_summary, m_docs.size(), out);
+    m_state = STREAM_DOCS;
+  }
+  while (m_pos < m_docs.size() && out.size() - from < kOutputChunkSize) {
+    size_t end = std::min(m_pos + kPackDocsBatch, m_docs.size());
+    m_packer->PackDocs(m_source, m_docs, m_pos, end, m_attributes, out);
+    m_pos = end;
+  }
+  m_wastetime_pack += WASTE_TIME_US(pack_start);
+  if (m_pos == m_docs.size()) {
+    m_packer->PackTail(m_summary, m_docs.size(),
+      intToString(m_wastetime_pack) + "us", out);
+    m_state = STREAM_DONE;
+  }
+
+  CachePart(out, from);
+  return true;
+}
+
+// the parts go in as they are sent, parse/segment/search/pack costs included,
+// those of a cache hit are only in its log line
+void LookaResultStream::CachePart(const LookaOutputBuffer& out, size_t from)
+{
+  if (!m_cache)
+    return;
+  if (!m_cache->Fits(m_cache_key, m_packed.size() + out.size() - from)) {
+    m_cache = NULL;
+    std::string().swap(m_packed);
+    return;
+  }
+  for (size_t i=0; i<out.GetChunkNum(); i++) {
+    const std::string& chunk = out.GetChunk(i);
+    if (from >= chunk.size()) {
+      from -= chunk.size();
+      continue;
+    }
+    m_packed.append(chunk, from, std::string::npos);
+    from = 0;
+  }
+  if (m_state == STREAM_DONE) {
+    m_cache->Put(m_cache_key, std::make_shared<const std::string>(std::move(m_packed)));
+    m_cache = NULL;
+    std::string().swap(m_packed);
+  }
+}
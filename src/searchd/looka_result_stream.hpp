@@ -0,0 +1,75 @@
+#ifndef _LOOKA_RESULT_STREAM_HPP
+#define _LOOKA_RESULT_STREAM_HPP
+#include <string>
+#include <vector>
+#include "../looka_types.hpp"
+#include "../looka_config_source.hpp"
+#include "../looka_attributes.hpp"
+#include "../looka_output_buffer.hpp"
+#include "../http_frame/http_body_stream.hpp"
+#include "looka_result_packer.hpp"
+#include "looka_result_cache.hpp"
+
+// Docs packed at a time, a part ends after the batch that makes it reach
+// kOutputChunkSize.
+const size_t kPackDocsBatch = 64;
+
+// A result packed while it is sent, a part of about kOutputChunkSize at a
+// time, so a large result is never held whole. It goes into the cache as
+// it is packed, as long as it fits there, and the query is logged with the
+// time packing took once the stream is done with.
+class LookaResultStream: public HttpBodyStream
+{
+public:
+  LookaResultStream(
+    LookaResultPacker* packer,
+    const LookaConfigSource* source,
+    const LookaAttributes* attributes);
+  virtual ~LookaResultStream();
+
+  // The result to pack, docs is taken over and left empty.
+  void SetResult(
+    const std::string& query,
+    std::vector<LocalDocID>& docs,
+    const std::vector<std::pair<std::string, std::string> >& extra);
+  // Put the packed result in cache under key.
+  void SetCache(LookaResultCache* cache, const std::string& key);
+  // The log line of the query, the costs up to the search.
+  void SetLog(const std::string& log,
+    int wastetime_parse, int wastetime_segment, int wastetime_search);
+
+  virtual bool Next(LookaOutputBuffer& out);
+
+private:
+  void CachePart(const LookaOutputBuffer& out, size_t from);
+
+private:
+  enum StreamState {
+    STREAM_HEAD = 0,
+    STREAM_DOCS,
+    STREAM_DONE,
+  };
+
+  LookaResultPacker* m_packer;
+  const LookaConfigSource* m_source;
+  const LookaAttributes* m_attributes;
+
+  std::vector<std::pair<std::string, std::string> > m_summary;
+  std::vector<LocalDocID> m_docs;
+  StreamState m_state;
+  // next doc to pack
+  size_t m_pos;
+  int m_wastetime_pack;
+
+  // NULL once the result grew too large for it
+  LookaResultCache* m_cache;
+  std::string m_cache_key;
+  std::string m_packed;
+
+  std::string m_log;
+  int m_wastetime_parse;
+  int m_wastetime_segment;
+  int m_wastetime_search;
+};
+
+#endif //_LOOKA_RESULT_STREAM_HPP
@@ -1,10 +1,12 @@
 #include <iostream>
 #include <string>
+#include <algorithm>
 #include <pthread.h>
 #include <signal.h>
-#include <libxml/parser.h>
+#include <strings.h>
 #include "../looka_file.hpp"
-#include "../looka_intersect.hpp"
+#include "../looka_query_executor.hpp"
+#include "../looka_wand.hpp"
 #include "looka_searchd.hpp"
 
 LookaSearchd::LookaSearchd(
@@ -29,52 +31,204 @@ LookaSearchd::LookaSearchd(
     _ERROR_EXIT(-1, "init segmenter failed");
   }
 
-  m_inverter = new LookaInverter<Token, DocInvert*>();
-  m_summary  = new std::vector<DocAttr*>();
-  m_result_packer_wrapper = new LookaResultPackerWrapper();
-  m_attr_names = new std::map<DocAttrType, AttrNames*>();
-
-  (*m_attr_names)[ATTR_TYPE_UINT]   = NULL;
-  (*m_attr_names)[ATTR_TYPE_FLOAT]  = NULL;
-  (*m_attr_names)[ATTR_TYPE_MULTI]  = NULL;
-  (*m_attr_names)[ATTR_TYPE_STRING] = NULL;
+  m_dictionary = new LookaDictionary();
+  m_attributes = new LookaAttributes();
+  m_ranker = new LookaRanker();
+  m_result_packer_wrapper = new LookaResultPackerWrapper(
+    m_source_cfg, m_searchd_cfg->json_styled != 0);
+  m_result_cache = NULL;
+  if (m_searchd_cfg->result_cache_size > 0)
+    m_result_cache = new LookaResultCache(
+      (uint64_t)m_searchd_cfg->result_cache_size * 1024 * 1024);
 
+  pthread_key_create(&m_seg_key, NULL);
   pthread_mutex_init(&m_seg_lock, NULL);
 }
 
 LookaSearchd::~LookaSearchd()
 {
+  for (size_t i=0; i<m_segmenters.size(); i++)
+    delete m_segmenters[i];
   if (m_segmenter)
     delete m_segmenter;
-  if (m_inverter)
-    delete m_inverter;
-  if (m_summary)
-    delete m_summary;
+  if (m_dictionary)
+    delete m_dictionary;
+  if (m_attributes)
+    delete m_attributes;
+  if (m_ranker)
+    delete m_ranker;
   if (m_result_packer_wrapper)
     delete m_result_packer_wrapper;
-  if (m_attr_names)
-    delete m_attr_names;
+  if (m_result_cache)
+    delete m_result_cache;
+  pthread_key_delete(m_seg_key);
   pthread_mutex_destroy(&m_seg_lock);
 }
 
+LookaSegmenter* LookaSearchd::GetSegmenter()
+{
+  LookaSegmenter* seg =
+    static_cast<LookaSegmenter*>(pthread_getspecific(m_seg_key));
+  if (seg)
+    return seg;
+
+  // once per thread, segmenting itself takes no lock
+  pthread_mutex_lock(&m_seg_lock);
+  seg = m_segmenter->Fork();
+  if (seg)
+    m_segmenters.push_back(seg);
+  pthread_mutex_unlock(&m_seg_lock);
+  if (!seg)
+    _ERROR_RETURN(NULL, "fork segmenter failed");
+  pthread_setspecific(m_seg_key, seg);
+  return seg;
+}
+
 bool LookaSearchd::Init()
 {
   _INFO("[reading index & summary ...]");
   LookaIndexReader* reader = new LookaIndexReader();
 
-  reader->ReadIndexFromFile(m_index_cfg->index_file, m_inverter);
-  reader->ReadSummaryFromFile(
-    m_index_cfg->summary_file_uint,
-    m_index_cfg->summary_file_float,
-    m_index_cfg->summary_file_multi,
-    m_index_cfg->summary_file_string,
-    m_attr_names,
-    m_summary);
+  bool ok =
+    reader->ReadIndexFromFile(m_index_cfg->index_file, m_dictionary) &&
+    reader->ReadSummaryFromFile(
+      m_index_cfg->summary_file_uint,
+      m_index_cfg->summary_file_float,
+      m_index_cfg->summary_file_multi,
+      m_index_cfg->summary_file_string,
+      m_attributes);
   delete reader;
+  if (ok)
+    m_ranker->Init(m_dictionary->GetNorms());
+  // replies of the index read before are stale
+  if (m_result_cache)
+    m_result_cache->Clear();
+  return ok;
+}
+
+int LookaSearchd::SearchTree(
+  const QueryNode* query, const std::vector<RankTerm>& terms,
+  const LookaFilter& filter, LookaTopK* top)
+{
+  int total = 0;
+  LocalDocID id = 0;
+  LookaQueryExecutor executor;
+  executor.Build(query, m_dictionary);
+  LookaScorer scorer;
+  if (top)
+    scorer.SetTerms(terms, m_dictionary, m_ranker);
+  uint32_t doc_num = m_attributes->GetDocNum();
+  LocalDocID block[kFilterBlockSize];
+  bool more = true;
+  while (more) {
+    // collect a block of candidates
+    uint32_t size = 0;
+    while (size < kFilterBlockSize) {
+      id = executor.Seek(id);
+      if (id == kIllegalLocalDocID || id >= doc_num) {
+        more = false;
+        break;
+      }
+      block[size++] = id++;
+    }
+
+    // match filter range
+    size = filter.SelectRanges(block, size);
+
+    for (uint32_t i=0; i<size; i++) {
+      // match filter
+      if (filter.Drop(block[i]))
+        continue;
+
+      // rank doc
+      if (top)
+        top->Push(block[i], scorer.Score(block[i]));
+      total++;
+    }
+  }
+  return total;
+}
+
+// An or of terms searched in every field, ranked with WAND.
+static bool IsTermDisjunction(const QueryNode* query)
+{
+  if (!query || query->type != QUERY_OR)
+    return false;
+  for (size_t i=0; i<query->children.size(); i++)
+    if (query->children[i]->type != QUERY_TERM ||
+        query->children[i]->fields != kAllQueryFields)
+      return false;
+  return true;
+}
+
+// The terms to rank with the field weights of the request, a term limited
+// to some fields weighs 0 in the others.
+static void GetRankTerms(
+  const std::vector<const QueryNode*>& terms,
+  const std::vector<std::string>& fields,
+  const std::map<std::string, float>& field_weights,
+  std::vector<RankTerm>& rank_terms)
+{
+  std::vector<float> weights(fields.size(), 1.0f);
+  bool weighted = false;
+  std::map<std::string, float>::const_iterator it;
+  for (it = field_weights.begin(); it != field_weights.end(); ++it) {
+    for (size_t f=0; f<fields.size(); f++) {
+      if (strcasecmp(fields[f].c_str(), it->first.c_str()) == 0) {
+        weights[f] = it->second;
+        weighted |= it->second != 1.0f;
+      }
+    }
+  }
+
+  for (size_t i=0; i<terms.size(); i++) {
+    RankTerm term;
+    term.token = terms[i]->token;
+    if (weighted || terms[i]->fields != kAllQueryFields) {
+      term.field_weights = weights;
+      for (size_t f=0; f<fields.size(); f++)
+        if (f >= 64 || !((terms[i]->fields >> f) & 1))
+          term.field_weights[f] = 0.0f;
+    }
+    rank_terms.push_back(term);
+  }
+}
+
+int LookaSearchd::SearchAny(
+  const QueryNode* query, const std::vector<RankTerm>& terms,
+  const LookaFilter& filter, bool exact_total, LookaTopK& top,
+  bool& total_exact)
+{
+  // docs that cannot beat the current top k are skipped unscored, so the
+  // count is a lower bound: the docs scored, or with nothing filtered the
+  // longest list, unless counting all matches was asked for
+  int scored = 0;
+  LookaWand wand;
+  wand.SetTokens(terms, m_dictionary, m_ranker);
+  uint32_t doc_num = m_attributes->GetDocNum();
+  float score;
+  LocalDocID id;
+  while ((id = wand.Next(top.Threshold(), score)) != kIllegalLocalDocID &&
+      id < doc_num) {
+    if (filter.SelectRanges(&id, 1) == 0 || filter.Drop(id))
+      continue;
+    top.Push(id, score);
+    scored++;
+  }
+
+  total_exact = exact_total;
+  if (exact_total)
+    return SearchTree(query, terms, filter, NULL);
+  if (filter.Empty())
+    return std::max(scored, static_cast<int>(
+      std::min(wand.GetMaxListSize(), doc_num)));
+  return scored;
 }
 
 bool LookaSearchd::Process(
-  const HttpRequest& request, std::string& reply, std::string& extension)
+  const HttpRequest& request, LookaOutputBuffer& reply,
+  std::shared_ptr<HttpBodyStream>& stream,
+  std::string& extension)
 {
   struct timeval parse_start;
   struct timeval segment_start;
@@ -82,7 +236,6 @@ bool LookaSearchd::Process(
   int wastetime_parse = 0;
   int wastetime_segment = 0;
   int wastetime_search = 0;
-  int wastetime_pack = 0;
 
   // parse query
   gettimeofday(&parse_start, NULL);
@@ -92,47 +245,63 @@ bool LookaSearchd::Process(
   extension = req.dataformat;
   wastetime_parse = WASTE_TIME_US(parse_start);
 
+  // a cached reply is the same as packing the result again, it is sent
+  // from the cache as it is, costs included, nothing is copied
+  std::string cache_key;
+  if (m_result_cache) {
+    cache_key = req.GetCacheKey();
+    std::shared_ptr<const std::string> cached;
+    if (m_result_cache->Get(cache_key, cached)) {
+      reply.AppendShared(cached);
+      _INFO("[query %s] [filter %s] [filter_range %s] "
+        "[cache hit] [cache_hits %llu cache_misses %llu] [cost %dus]",
+        req.query.c_str(),
+        req.filter_string.c_str(),
+        req.filter_range_string.c_str(),
+        (unsigned long long)m_result_cache->GetHits(),
+        (unsigned long long)m_result_cache->GetMisses(),
+        WASTE_TIME_US(parse_start));
+      return true;
+    }
+  }
+
   // segment query
   gettimeofday(&segment_start, NULL);
-  std::vector<SegmentToken> segtokens;
-  pthread_mutex_lock(&m_seg_lock);
-  m_segmenter->Segment(req.query, segtokens);
-  pthread_mutex_unlock(&m_seg_lock);
+  LookaQueryParser parser(
+    GetSegmenter(), m_source_cfg->sql_field_string, req.match == "any");
+  QueryNode* query = parser.Parse(req.query);
+  std::vector<const QueryNode*> terms;
+  GetQueryTerms(query, terms);
+  std::vector<RankTerm> rank_terms;
+  GetRankTerms(
+    terms, m_source_cfg->sql_field_string, req.field_weights, rank_terms);
   wastetime_segment = WASTE_TIME_US(segment_start);
 
   // do search
   gettimeofday(&search_start, NULL);
   int total = 0;
-  LocalDocID id = 0;
-  std::vector<DocAttr*> docs;
-  LookaIntersect* inter = new LookaIntersect();
-  std::vector<std::string> strtokens;
-  for (size_t i=0; strtokens.size()<segtokens.size();
-    strtokens.push_back(segtokens[i++].str));
-  inter->SetTokens(strtokens, m_inverter);
-  while ((id = inter->Seek(id)) != kIllegalLocalDocID) {
-    DocAttr*& attr = (*m_summary)[id++];
-
-    // match filter
-    if (DropByFilter(attr, req.filter))
-      continue;
-
-    // match filter range
-    if (DropByFilterRange(attr, req.filter_range))
-      continue;
-
-    // match doc
-    if (total >= req.offset && total < req.offset + req.limit) {
-      docs.push_back(attr);
-    }
-    total++;
+  std::vector<LocalDocID> docs;
+  LookaFilter filter;
+  filter.Compile(req.filter, req.filter_range, m_attributes);
+  // only the best offset + limit docs are kept
+  int64_t top_k = (int64_t)std::max(req.offset, 0) + std::max(req.limit, 0);
+  LookaTopK top(static_cast<uint32_t>(std::min<int64_t>(top_k, kuint32max)));
+  bool total_exact = true;
+  if (IsTermDisjunction(query)) {
+    total = SearchAny(
+      query, rank_terms, filter, req.exact_total, top, total_exact);
+  } else if (query) {
+    total = SearchTree(query, rank_terms, filter, &top);
   }
+  top.GetDocs(static_cast<uint32_t>(std::max(req.offset, 0)), docs);
   wastetime_search = WASTE_TIME_US(search_start);
 
-  // pack result
+  // pack result, a reply replayed from the cache keeps these costs
   std::vector<std::pair<std::string, std::string> > extra;
   extra.push_back(
     std::make_pair("total_found", intToString(total)));
+  if (!total_exact)
+    extra.push_back(std::make_pair("total_found_exact", "0"));
   extra.push_back(
     std::make_pair("parse_cost", intToString(wastetime_parse) + "us"));
   extra.push_back(
@@ -140,88 +309,23 @@ bool LookaSearchd::Process(
   extra.push_back(
     std::make_pair("search_cost", intToString(wastetime_search) + "us"));
 
-  LookaResultPacker* packer =
-    m_result_packer_wrapper->GetResultPacker(req.dataformat);
-  reply = packer->PackResult(m_source_cfg, req.query, strtokens,
-    docs, m_attr_names, inter, m_inverter, extra, wastetime_pack);
-
-  delete inter;
-
-  _INFO("[query %s] [filter %s] [filter_range %s] "
-    "[total_found %d] [return_num %d] [cost(%d %d %d %d) %dus]",
-    req.query.c_str(),
-    req.filter_string.c_str(),
-    req.filter_range_string.c_str(),
-    total,
-    static_cast<int>(docs.size()),
-    wastetime_parse,
-    wastetime_segment,
-    wastetime_search,
-    wastetime_pack,
-    wastetime_parse + wastetime_segment + wastetime_search + wastetime_pack);
+  delete query;
 
-  return true;
-}
+  // packed while it is sent, the stream logs the query once it is done
+  std::string log = "[query " + req.query + "] [filter " +
+    req.filter_string + "] [filter_range " + req.filter_range_string +
+    "] [total_found " + intToString(total) + "] [return_num " +
+    intToString(static_cast<int>(docs.size())) + "]";
+  std::shared_ptr<LookaResultStream> result =
+    std::make_shared<LookaResultStream>(
+      m_result_packer_wrapper->GetResultPacker(req.dataformat),
+      m_source_cfg, m_attributes);
+  result->SetResult(req.query, docs, extra);
+  if (m_result_cache)
+    result->SetCache(m_result_cache, cache_key);
+  result->SetLog(log, wastetime_parse, wastetime_segment, wastetime_search);
+  stream = result;
 
-bool LookaSearchd::GetAttrNameIndex(
-  const std::string& s, DocAttrType& type, int& index)
-{
-  if (!m_attr_names)
-    return false;
-  if (s.empty())
-    return false;
-
-  bool found = false;
-  std::map<DocAttrType, AttrNames*>::iterator it = m_attr_names->begin();
-  for (it; it != m_attr_names->end(); ++it) {
-    AttrNames*& attr = it->second;
-    for (uint8_t i=0; i<attr->size; i++) {
-      if (attr->GetString(i) == s) {
-        type = it->first;
-        index = static_cast<int>(i);
-        found = true;
-        break;
-      }
-    }
-  }
-  return found;
-}
-
-bool LookaSearchd::DropByFilter(
-  const DocAttr* attr, const LookaRequest::Filter_t& filter)
-{
-  bool hit = false;
-  int idx;
-  DocAttrType type;
-  LookaRequest::FilterConstIter_t it;
-  for (it=filter.begin(); it!=filter.end(); ++it) {
-    const std::string& filter_key = it->first;
-    const std::vector<std::string>& filter_values = it->second;
-    if (!GetAttrNameIndex(filter_key, type, idx))
-      continue;
-
-    std::string s;
-    if (type == ATTR_TYPE_UINT) {
-      s = StringPrintf("%u", attr->u->data[idx]);
-    } else if (type == ATTR_TYPE_FLOAT) {
-      s = StringPrintf("%f", attr->f->data[idx]);
-    } else if (type == ATTR_TYPE_MULTI) {
-      s = StringPrintf("%u", attr->m->data[idx]);
-    } else if (type == ATTR_TYPE_STRING) {
-      s = attr->s->GetString(idx);
-    }
-
-    if (std::find(filter_values.begin(), filter_values.end(), s) ==
-      filter_values.end()) {
-      hit = true;
-      break;
-    }
-  }
-  return hit;
+  return true;
 }
 
-bool LookaSearchd::DropByFilterRange(
-  const DocAttr* attr, const LookaRequest::FilterRange_t& filter_range)
-{
-  return false;
-}
@@ -7,10 +7,16 @@
 #include "../looka_config_index.hpp"
 #include "../looka_config_searchd.hpp"
 #include "../looka_config_source.hpp"
-#include "../looka_inverter.hpp"
+#include "../looka_dictionary.hpp"
+#include "../looka_attributes.hpp"
+#include "../looka_ranker.hpp"
+#include "../looka_query.hpp"
 #include "../http_frame/server_handler.hpp"
 #include "looka_result_packer.hpp"
+#include "looka_result_cache.hpp"
+#include "looka_result_stream.hpp"
 #include "looka_request.hpp"
+#include "looka_filter.hpp"
 
 class LookaSearchd: public ServerHandler
 {
@@ -23,13 +29,27 @@ public:
 
   bool Init();
   virtual bool Process(
-    const HttpRequest& request, std::string& reply, std::string& extension);
+    const HttpRequest& request, LookaOutputBuffer& reply,
+    std::shared_ptr<HttpBodyStream>& stream,
+    std::string& extension);
 
 private:
-  bool DropByFilter(const DocAttr* attr, const LookaRequest::Filter_t& filter);
-  bool DropByFilterRange(
-    const DocAttr* attr, const LookaRequest::FilterRange_t& filter_range);
-  bool GetAttrNameIndex(const std::string& s, DocAttrType& type, int& index);
+  // Rank the docs matching the query into top, or only count them if
+  // top is NULL. Returns the number of docs matching.
+  int SearchTree(
+    const QueryNode* query, const std::vector<RankTerm>& terms,
+    const LookaFilter& filter, LookaTopK* top);
+  // Rank the docs matching any of the tokens of an or of terms into top
+  // with WAND. Returns a lower bound of the docs matching, or their exact
+  // number with exact_total, total_exact tells which one.
+  int SearchAny(
+    const QueryNode* query, const std::vector<RankTerm>& terms,
+    const LookaFilter& filter, bool exact_total, LookaTopK& top,
+    bool& total_exact);
+
+  // The segmenter of the calling thread, forked from m_segmenter on the
+  // first call.
+  LookaSegmenter* GetSegmenter();
 
 public:
   LookaConfigSource*  m_source_cfg;
@@ -37,11 +57,16 @@ public:
   LookaConfigSearchd* m_searchd_cfg;
 
   LookaSegmenter*     m_segmenter;
-  LookaInverter<Token, DocInvert*>* m_inverter;
-  std::vector<DocAttr*>* m_summary;
+  LookaDictionary*    m_dictionary;
+  LookaAttributes*    m_attributes;
+  LookaRanker*        m_ranker;
   LookaResultPackerWrapper* m_result_packer_wrapper;
-  std::map<DocAttrType, AttrNames*>* m_attr_names;
+  // NULL if result_cache_size is 0
+  LookaResultCache*   m_result_cache;
 
+  // forks of m_segmenter, one per worker thread
+  std::vector<LookaSegmenter*> m_segmenters;
+  pthread_key_t   m_seg_key;
   pthread_mutex_t m_seg_lock;
 };
 
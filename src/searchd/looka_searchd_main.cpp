@@ -95,7 +95,8 @@ int main(int argc, char** argv)
     LookaConfigSource* source_cfg = it->second;
 
     searchd = new LookaSearchd(source_cfg, index_cfg, lc_searchd);
-    searchd->Init();
+    if (!searchd->Init())
+      _ERROR_EXIT(-1, "searchd init failed");
     _INFO("searchd init ok");
     break;
   }
@@ -111,6 +112,8 @@ int main(int argc, char** argv)
 
   HttpServer s(listen_port, thread_num);
   s.SetServerName("looka-searchd");
+  s.SetIdleTimeout(searchd->m_searchd_cfg->client_timeout);
+  s.SetReadTimeout(searchd->m_searchd_cfg->read_timeout);
   // Set server handler for process request
   s.SetServerHandler(searchd);
   s.Start();